@@ -0,0 +1,213 @@
+// Allocation check, runs the animation world over a synthetic crowd and fails when a steady state
+// frame allocates from the heap.
+//
+//   allocation_check [instances] [frames]
+//
+// Every global operator new is counted. Instances toggle between a clip and a blend space state
+// every TogglePeriod frames so transitions, blend poses and the frame arenas are exercised. The first WarmupFrames
+// frames may allocate while the arenas grow to their peak, every later frame must not. Instances
+// are GPU skinned, CPU skinning uploads to GL buffers which needs a context. Returns 0 on success.
+#include "AnimationWorld.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+namespace
+{
+    std::atomic<unsigned long long> gAllocationCount{ 0 };
+
+    constexpr unsigned int JointCount = 40;
+    constexpr unsigned int TogglePeriod = 40;
+    // Two full toggle cycles, every state and transition has been played by then
+    constexpr unsigned int WarmupFrames = TogglePeriod * 4;
+
+    // A chain of joints swinging around one axis, every joint animated
+    animation::Clip MakeClip(const char* name, float duration, float swing)
+    {
+        animation::Clip clip;
+        clip.name = name;
+        for (unsigned int joint = 0; joint < JointCount; ++joint)
+        {
+            animation::TransformTrack track;
+            track.boneID = joint;
+            animation::QuaternionFrame* frames = track.rotation.frames.Resize(3);
+            for (unsigned int i = 0; i < 3; ++i)
+            {
+                frames[i].time = duration * i * 0.5f;
+                frames[i].value = math::normalized(math::Quaternion(0.0f, i == 1 ? swing : 0.0f, 0.0f, 1.0f));
+            }
+            track.rotation.UpdateIndexLookupTable();
+            clip.tracks.push_back(track);
+        }
+        clip.RecalculateDuration();
+        return clip;
+    }
+}
+
+void* operator new(size_t size)
+{
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* result = malloc(size > 0 ? size : 1);
+    if (result == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    const size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+    void* result = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+    void* result = aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+    if (result == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int instanceCount = argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 2000;
+    unsigned int frameCount = argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : WarmupFrames + 200;
+    if (frameCount <= WarmupFrames)
+    {
+        std::cout << "usage: allocation_check [instances] [frames], frames must be over " << WarmupFrames << std::endl;
+        return 1;
+    }
+
+    std::vector<animation::ClipHandle> clips;
+    clips.push_back(std::make_shared<const animation::Clip>(MakeClip("Walking", 1.0f, 0.2f)));
+    clips.push_back(std::make_shared<const animation::Clip>(MakeClip("Running", 0.7f, -0.3f)));
+
+    // Running is a blend space state, so blend space lookups and blended sampling are checked too
+    animation::BlendSpace2D movement;
+    movement.AddSample(0, 0.0f, 0.0f);
+    movement.AddSample(1, 1.0f, 0.0f);
+    movement.AddSample(0, 0.0f, 1.0f);
+
+    animation::StateMachineDefinition definition;
+    unsigned int speed = definition.AddParameter("speed");
+    unsigned int lean = definition.AddParameter("lean");
+    unsigned int walking = definition.AddState("Walking", 0);
+    unsigned int running = definition.AddBlendSpaceState("Running", definition.AddBlendSpace(movement), speed, lean);
+    unsigned int toRunning = definition.AddTransition(walking, running, 0.3f);
+    definition.AddCondition(toRunning, speed, animation::CONDITION::GREATER, 0.5f);
+    unsigned int toWalking = definition.AddTransition(running, walking, 0.3f);
+    definition.AddCondition(toWalking, speed, animation::CONDITION::LESS, 0.5f);
+
+    animation::StateMachine stateMachine;
+    if (!stateMachine.Compile(definition, clips))
+    {
+        return 1;
+    }
+
+    skin::Skeleton skeleton;
+    skeleton.restPose.Resize(JointCount);
+    for (unsigned int joint = 0; joint < JointCount; ++joint)
+    {
+        skeleton.restPose.parents[joint] = static_cast<int>(joint) - 1;
+        skeleton.restPose.joints[joint].position = math::vec3(0.0f, joint > 0 ? 0.1f : 0.0f, 0.0f);
+    }
+    skeleton.bindPose = skeleton.restPose;
+    skeleton.UpdateInverseBindPose();
+    std::vector<skin::AnimatedMesh> meshes;
+
+    jobs::JobSystem jobSystem;
+    jobSystem.Initialize();
+
+    // A grid in front of the camera, far rows drop to lower update rates
+    animation::AnimationWorld world;
+    world.Initialize(skeleton, stateMachine, meshes, &jobSystem);
+    world.Reserve(instanceCount);
+    world.SetUpdateRateLevels({ { 0.05f, 1 }, { 0.01f, 2 }, { 0.0f, 4 } }, animation::UPDATE_RATE_BLEND::INTERPOLATE);
+    world.SetCamera(math::lookAt(math::vec3(0, 5, 7), math::vec3(0, 3, 0), math::vec3(0, 1, 0)),
+        math::transposed(math::perspective(60.0f, 16.0f / 9.0f, 0.01f, 1000.0f)));
+    for (unsigned int i = 0; i < instanceCount; ++i)
+    {
+        math::Transform model;
+        model.position = math::vec3(static_cast<float>(i % 50) - 25.0f, 0.0f, -static_cast<float>(i / 50));
+        world.Add(model, stateMachine.CreateInstance(), false);
+    }
+
+    unsigned int failedFrames = 0;
+    unsigned long long steadyAllocations = 0;
+    for (unsigned int frame = 0; frame < frameCount; ++frame)
+    {
+        unsigned long long before = gAllocationCount.load();
+
+        // Same order as the app: frame fence, parameters, next frame, upload
+        world.EndUpdate();
+        if (frame % TogglePeriod == 0)
+        {
+            float value = (frame / TogglePeriod) % 2 == 0 ? 1.0f : 0.0f;
+            for (unsigned int i = 0; i < world.Size(); ++i)
+            {
+                stateMachine.SetParameter(world.GetState(i), speed, value);
+                stateMachine.SetParameter(world.GetState(i), lean, static_cast<float>(i % 4) * 0.25f);
+            }
+        }
+        world.BeginUpdate(1.0f / 60.0f);
+        world.Upload();
+
+        unsigned long long allocations = gAllocationCount.load() - before;
+        if (frame >= WarmupFrames && allocations > 0)
+        {
+            if (failedFrames < 10)
+            {
+                std::cout << "Frame " << frame << ": " << allocations << " heap allocations" << std::endl;
+            }
+            ++failedFrames;
+            steadyAllocations += allocations;
+        }
+    }
+    world.EndUpdate();
+    world.Clear();
+    jobSystem.Shutdown();
+
+    if (failedFrames > 0)
+    {
+        std::cout << "FAILED: " << failedFrames << " of " << frameCount - WarmupFrames << " steady state frames allocated, "
+            << steadyAllocations << " allocations in total" << std::endl;
+        return 1;
+    }
+    std::cout << "OK: " << frameCount - WarmupFrames << " steady state frames of " << instanceCount
+        << " instances made no heap allocations" << std::endl;
+    return 0;
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <memory>
 #include <vector>
 #include "Math.h"
 #include "Transform.h"
+#include "utils.h"
 
 namespace animation
 {
@@ -35,6 +39,15 @@ namespace animation
             return math::normalized(result);
         }
 
+        inline math::Transform Blend(const math::Transform& a, const math::Transform& b, const float t)
+        {
+            math::Transform result;
+            result.position = math::lerp(a.position, b.position, t);
+            result.rotation = Interpolate(a.rotation, b.rotation, t);
+            result.scale = math::lerp(a.scale, b.scale, t);
+            return result;
+        }
+
         inline void Neighbourhood(const math::Quaternion& a, math::Quaternion& b)
         {
             if (math::dot(a, b))
@@ -97,16 +110,17 @@ namespace animation
     struct Track
     {
         constexpr static inline unsigned int samplerRate = 60;
-        std::vector<Frame<T>> frames;
+        // Views of a cooked file for clips loaded from one, see Clip::storage
+        utils::Array<Frame<T>> frames;
         // Index lookup table
-        std::vector<unsigned int> sampledFrames;
+        utils::Array<unsigned int> sampledFrames;
         INTERPOLATION interpolationKind;
         
         Track(INTERPOLATION kind = INTERPOLATION::LINEAR)
             :interpolationKind(kind)
         {}
 
-        inline float GetStartTime()
+        inline float GetStartTime() const
         {
             float t = 0;
             if (!frames.empty())
@@ -116,7 +130,7 @@ namespace animation
             return t;
         }
 
-        inline float GetEndTime()
+        inline float GetEndTime() const
         {
             float t = 0;
             if (!frames.empty())
@@ -126,7 +140,7 @@ namespace animation
             return t;
         }
     
-        inline T Sample(float time, bool looping, INTERPOLATION interpolation = INTERPOLATION::LINEAR)
+        inline T Sample(float time, bool looping, INTERPOLATION interpolation = INTERPOLATION::LINEAR) const
         {
             T value;
             int currentFrameIndex = GetFrameIndex(time, looping);
@@ -191,7 +205,7 @@ namespace animation
 
             const float duration = GetEndTime() - GetStartTime();
             unsigned int sampleCount = static_cast<unsigned int>(duration * samplerRate);
-            sampledFrames.resize(sampleCount);
+            unsigned int* table = sampledFrames.Resize(sampleCount);
 
             for (unsigned int i = 0; i < sampleCount; ++i)
             {
@@ -211,13 +225,13 @@ namespace animation
                         break;
                     }
                 }
-                sampledFrames[i] = frameIndex;
+                table[i] = frameIndex;
             }
         }
 
         // Protected helper function
         // Finds the frame index right before a given time
-        inline int GetFrameIndex(float time, bool looping)
+        inline int GetFrameIndex(float time, bool looping) const
         {
             unsigned int size = (unsigned int)frames.size();
             int result = -1;
@@ -274,7 +288,7 @@ namespace animation
         }
 
         // To be called when the playback time of an animation changes
-        inline float AdjustTimeToFitTrack(float time, bool looping)
+        inline float AdjustTimeToFitTrack(float time, bool looping) const
         {
             unsigned int size = (unsigned int)frames.size();
             if (size < 2)
@@ -323,7 +337,7 @@ namespace animation
 
     struct TransformTrack
     {
-        inline float GetStartTime()
+        inline float GetStartTime() const
         {
             float result = 0.0f;
             bool resultSet = false;
@@ -356,7 +370,7 @@ namespace animation
             return result;
         }
 
-        inline float GetEndTime()
+        inline float GetEndTime() const
         {
             float result = 0.0f;
             bool resultSet = false;
@@ -389,13 +403,13 @@ namespace animation
             return result;
         }
 
-        inline bool IsValid()
+        inline bool IsValid() const
         {
             return ((position.frames.size() > 1) || (rotation.frames.size() > 1) ||
                 (scale.frames.size() > 1));
         }
 
-        inline math::Transform Sample(const math::Transform& ref, float time, bool looping)
+        inline math::Transform Sample(const math::Transform& ref, float time, bool looping) const
         {
             math::Transform result = ref;
             if (position.frames.size() > 1)
@@ -421,6 +435,98 @@ namespace animation
         VectorTrack scale;   
     };
 
+    // Non owning pose, the joints live in memory owned by someone else (a slab of poses for example)
+    // and the parents are usually the skeleton's.
+    struct PoseView
+    {
+        math::Transform* joints = nullptr;
+        const int* parents = nullptr;
+        unsigned int size = 0;
+
+        inline unsigned int Size() const
+        {
+            return size;
+        }
+
+        inline math::Transform& LocalTransform(unsigned int index) const
+        {
+            return joints[index];
+        }
+
+        inline math::Transform GlobalTransform(unsigned int index) const
+        {
+            math::Transform result = joints[index];
+            for (int parent = parents[index]; parent >= 0; parent = parents[parent])
+            {
+                result = combine(joints[parent], result);
+            }
+            return result;
+        }
+
+        // Single pass over the hierarchy when parents come before their children,
+        // joints that do not follow that order walk up to the root instead. out must hold Size() transforms.
+        inline void GetGlobalTransforms(math::Transform* out) const
+        {
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                int parent = parents[i];
+                if (parent < 0)
+                {
+                    out[i] = joints[i];
+                }
+                else if (parent < (int)i)
+                {
+                    out[i] = combine(out[parent], joints[i]);
+                }
+                else
+                {
+                    out[i] = GlobalTransform(i);
+                }
+            }
+        }
+
+        // Same as above for a subset of the joints, listed in ascending order along with their parents.
+        // The other entries of out are not written.
+        inline void GetGlobalTransforms(math::Transform* out, const unsigned int* subset, unsigned int count) const
+        {
+            for (unsigned int j = 0; j < count; ++j)
+            {
+                unsigned int i = subset[j];
+                int parent = parents[i];
+                if (parent < 0)
+                {
+                    out[i] = joints[i];
+                }
+                else if (parent < (int)i)
+                {
+                    out[i] = combine(out[parent], joints[i]);
+                }
+                else
+                {
+                    out[i] = GlobalTransform(i);
+                }
+            }
+        }
+
+        // out must hold Size() matrices
+        inline void GetMatrixPalette(math::mat4* out) const
+        {
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                out[i] = MatrixFromTransform(GlobalTransform(i));
+            }
+        }
+
+        // Copies the local transforms only, both views must have the same size
+        inline void CopyFrom(const PoseView& other) const
+        {
+            if (joints != other.joints && size != 0)
+            {
+                memcpy(joints, other.joints, sizeof(math::Transform) * size);
+            }
+        }
+    };
+
     // Represents the state of an animation at a given time.
     struct Pose
     {
@@ -433,12 +539,12 @@ namespace animation
             parents.resize(size);
         }
 
-        inline unsigned int Size()
+        inline unsigned int Size() const
         {
             return (unsigned int)joints.size();
         }
 
-        inline void GetMatrixPalette(std::vector<math::mat4>& out)
+        inline void GetMatrixPalette(std::vector<math::mat4>& out) const
         {
             unsigned int size = Size();
             if (size != out.size())
@@ -453,6 +559,15 @@ namespace animation
             }
         }
 
+        inline PoseView View()
+        {
+            PoseView view;
+            view.joints = joints.data();
+            view.parents = parents.data();
+            view.size = Size();
+            return view;
+        }
+
         inline Pose& operator=(const Pose& p)
         {
             if (&p == this)
@@ -531,15 +646,55 @@ namespace animation
         }
     };
 
+    // Cross-fades two poses of the same skeleton, t = 0 gives a and t = 1 gives b.
+    // All three views must have the same size, out may alias a or b.
+    inline void Blend(const PoseView& out, const PoseView& a, const PoseView& b, float t)
+    {
+        for (unsigned int i = 0; i < a.size; ++i)
+        {
+            out.joints[i] = helper::Blend(a.joints[i], b.joints[i], t);
+        }
+    }
+
+    inline void Blend(Pose& out, const Pose& a, const Pose& b, float t)
+    {
+        if (out.joints.size() != a.joints.size())
+        {
+            out = a;
+        }
+        Blend(out.View(), const_cast<Pose&>(a).View(), const_cast<Pose&>(b).View(), t);
+    }
+
+    struct JointMask;
+
+    enum class LOOP_MODE
+    {
+        ONCE,
+        LOOP
+    };
+
+    // Per-instance playback of a clip, the clip itself is shared and never modified
+    struct PlaybackState
+    {
+        float time = 0.0f;   // clip time, wrapped or clamped according to loopMode
+        float speed = 1.0f;
+        LOOP_MODE loopMode = LOOP_MODE::LOOP;
+        float cursor = 0.0f; // normalized position of the last sample in [0, 1]
+    };
+
+    // Immutable once loaded, shared between every instance and renderer through a ClipHandle
     struct Clip
     {
         std::vector<TransformTrack> tracks;
+        // Dense joint index -> track index, -1 for joints without a track
+        utils::Array<int> jointToTrack;
+        // The cooked file the arrays of the clip view, null when they own their elements
+        std::shared_ptr<const utils::MappedFile> storage;
         std::string name = "No name";
-        bool looping = false;
         float startTime = 0.f;
         float endTime = 0.f;
 
-        inline float AdjustTimeToFitRange(float time)
+        inline float AdjustTimeToFitRange(float time, bool loop) const
         {
             const float duration = endTime - startTime;
 
@@ -548,7 +703,7 @@ namespace animation
                 return 0.0f;
             }
 
-            if (looping)
+            if (loop)
             {
                 time = fmod(time - startTime, endTime - startTime);
 
@@ -579,43 +734,125 @@ namespace animation
             return tracks[index].boneID;
         }
 
-        inline TransformTrack& operator[](unsigned int jointIndex)
+        // O(1), returns nullptr if the joint is not animated by this clip.
+        // Only valid once the clip is finalized with RecalculateDuration.
+        inline const TransformTrack* GetTrack(unsigned int jointIndex) const
         {
-            for (unsigned int i = 0; i < tracks.size(); ++i)
+            if (jointIndex >= jointToTrack.size() || jointToTrack[jointIndex] < 0)
             {
-                if (tracks[i].boneID == jointIndex)
-                {
-                    return tracks[i];
-                }
+                return nullptr;
             }
+            return &tracks[jointToTrack[jointIndex]];
+        }
+
+        // Load time only, the caller is responsible for not adding a joint twice.
+        // Invalidates the joint lookup table until RecalculateDuration is called again.
+        inline TransformTrack& AddTrack(unsigned int jointIndex)
+        {
             TransformTrack track;
             track.boneID = jointIndex;
             tracks.push_back(track);
             return tracks[tracks.size() - 1];
         }
 
-        inline float Sample(Pose& outPose, float time)
+        // Advances the playback state by deltaTime and samples the clip at the new time
+        inline float Sample(Pose& outPose, PlaybackState& state, float deltaTime) const
+        {
+            return Sample(outPose.View(), state, deltaTime);
+        }
+
+        inline float Sample(const PoseView& outPose, PlaybackState& state, float deltaTime) const
+        {
+            const float time = state.time + deltaTime * state.speed;
+            state.time = Sample(outPose, time, state.loopMode == LOOP_MODE::LOOP);
+            const float duration = GetDuration();
+            state.cursor = duration > 0.0f ? (state.time - startTime) / duration : 0.0f;
+            return state.time;
+        }
+
+        inline float Sample(Pose& outPose, float time, bool loop) const
+        {
+            return Sample(outPose.View(), time, loop);
+        }
+
+        inline float Sample(const PoseView& outPose, float time, bool loop) const
         {
             if (GetDuration() == 0.f)
             {
                 return 0.f;
             }
 
-            time = AdjustTimeToFitRange(time);
+            time = AdjustTimeToFitRange(time, loop);
             unsigned int size = static_cast<unsigned int>(tracks.size());
             for (unsigned int i = 0; i < size; ++i)
             {
                 unsigned int jointIndex = tracks[i].boneID;
                 math::Transform localTransform = outPose.LocalTransform(jointIndex);
-                math::Transform animated = tracks[i].Sample(localTransform, time, looping);
+                math::Transform animated = tracks[i].Sample(localTransform, time, loop);
                 math::Transform& updatedTransform = outPose.LocalTransform(jointIndex);
                 updatedTransform = animated;
             }
             return time;
         }
 
+        // Only evaluates the tracks of joints enabled in the mask, which must have bound this clip to slot
+        inline float Sample(Pose& outPose, float time, bool loop, const JointMask& mask, unsigned int slot) const
+        {
+            return Sample(outPose.View(), time, loop, mask, slot);
+        }
+
+        inline float Sample(const PoseView& outPose, float time, bool loop, const JointMask& mask, unsigned int slot) const;
+
+        // Samples the clip and blends the joints it animates into outPose, t = 1 gives the clip alone
+        inline float SampleBlended(const PoseView& outPose, float time, bool loop, float t) const
+        {
+            if (GetDuration() == 0.f)
+            {
+                return 0.f;
+            }
+
+            time = AdjustTimeToFitRange(time, loop);
+            unsigned int size = static_cast<unsigned int>(tracks.size());
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                math::Transform& transform = outPose.LocalTransform(tracks[i].boneID);
+                transform = helper::Blend(transform, tracks[i].Sample(transform, time, loop), t);
+            }
+            return time;
+        }
+
+        // Same as above, only the joints enabled in mask are sampled
+        inline float SampleBlended(const PoseView& outPose, float time, bool loop, float t, const JointMask& mask,
+            unsigned int slot) const;
+
+        // Finalizes the clip: sorts tracks by joint so sampling writes the pose sequentially,
+        // rebuilds the joint lookup table and recomputes the time range.
         inline void RecalculateDuration()
         {
+            std::sort(tracks.begin(), tracks.end(), [](const TransformTrack& a, const TransformTrack& b)
+            {
+                return a.boneID < b.boneID;
+            });
+
+            unsigned int jointCount = 0;
+            for (unsigned int i = 0; i < tracks.size(); ++i)
+            {
+                if (tracks[i].boneID != (unsigned int)-1)
+                {
+                    jointCount = std::max(jointCount, tracks[i].boneID + 1);
+                }
+            }
+
+            int* table = jointToTrack.Resize(jointCount);
+            std::fill(table, table + jointCount, -1);
+            for (unsigned int i = 0; i < tracks.size(); ++i)
+            {
+                if (tracks[i].boneID < jointCount)
+                {
+                    table[tracks[i].boneID] = i;
+                }
+            }
+
             startTime = 0.0f;
             bool startSet = false;
             endTime = 0.0f;
@@ -641,14 +878,150 @@ namespace animation
             }
         }
 
-        inline float GetDuration()
+        inline float GetDuration() const
         {
             return endTime - startTime;
         }
 
-        inline unsigned int Size()
+        inline unsigned int Size() const
         {
             return static_cast<unsigned int>(tracks.size());
         }
     };
+
+    typedef std::shared_ptr<const Clip> ClipHandle;
+
+    // Subset of a skeleton's joints, e.g. the arms for an upper body layer.
+    // The indices of the clip tracks driving the enabled joints are bound once per clip at load
+    // time, each clip in its own slot, so masked sampling walks a precomputed list.
+    struct JointMask
+    {
+        std::vector<unsigned char> joints;
+
+        JointMask(unsigned int jointCount = 0, bool enabled = false)
+            :joints(jointCount, enabled ? 1 : 0)
+        {}
+
+        JointMask(unsigned int jointCount, const std::vector<unsigned int>& enabledJoints)
+            :joints(jointCount, 0)
+        {
+            for (unsigned int joint : enabledJoints)
+            {
+                if (joint < jointCount)
+                {
+                    joints[joint] = 1;
+                }
+            }
+        }
+
+        inline void Set(unsigned int joint, bool enabled)
+        {
+            if (joint >= joints.size())
+            {
+                joints.resize(joint + 1, 0);
+            }
+            joints[joint] = enabled ? 1 : 0;
+            // Bound track lists are stale now, the clips have to be bound again
+            bindings.clear();
+        }
+
+        inline bool IsEnabled(unsigned int joint) const
+        {
+            return joint < joints.size() && joints[joint] != 0;
+        }
+
+        // Enables a joint and all of its descendants
+        inline void SetHierarchy(const Pose& pose, unsigned int root, bool enabled)
+        {
+            unsigned int size = static_cast<unsigned int>(pose.parents.size());
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                for (int joint = i; joint >= 0; joint = pose.parents[joint])
+                {
+                    if (joint == (int)root)
+                    {
+                        Set(i, enabled);
+                        break;
+                    }
+                }
+            }
+        }
+
+        // Load time only, not thread safe. Lists the tracks of clip driving enabled joints in the
+        // next free slot and returns it. The mask keeps the clip alive while it is bound.
+        inline unsigned int Bind(const ClipHandle& clip)
+        {
+            Binding binding;
+            binding.clip = clip;
+            for (unsigned int i = 0; i < clip->tracks.size(); ++i)
+            {
+                if (IsEnabled(clip->tracks[i].boneID))
+                {
+                    binding.tracks.push_back(i);
+                }
+            }
+            bindings.push_back(binding);
+            return static_cast<unsigned int>(bindings.size() - 1);
+        }
+
+        inline void ClearBindings()
+        {
+            bindings.clear();
+        }
+
+        // O(1), the tracks of clip driving enabled joints
+        inline const std::vector<unsigned int>& GetTracks(const Clip& clip, unsigned int slot) const
+        {
+            assert(slot < bindings.size() && bindings[slot].clip.get() == &clip && "Clip is not bound to this mask slot");
+            return bindings[slot].tracks;
+        }
+
+    private:
+        struct Binding
+        {
+            ClipHandle clip;
+            std::vector<unsigned int> tracks;
+        };
+
+        std::vector<Binding> bindings;
+    };
+
+    inline float Clip::Sample(const PoseView& outPose, float time, bool loop, const JointMask& mask, unsigned int slot) const
+    {
+        if (GetDuration() == 0.f)
+        {
+            return 0.f;
+        }
+
+        time = AdjustTimeToFitRange(time, loop);
+        const std::vector<unsigned int>& active = mask.GetTracks(*this, slot);
+        unsigned int size = static_cast<unsigned int>(active.size());
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            const TransformTrack& track = tracks[active[i]];
+            math::Transform& transform = outPose.LocalTransform(track.boneID);
+            transform = track.Sample(transform, time, loop);
+        }
+        return time;
+    }
+
+    inline float Clip::SampleBlended(const PoseView& outPose, float time, bool loop, float t, const JointMask& mask,
+        unsigned int slot) const
+    {
+        if (GetDuration() == 0.f)
+        {
+            return 0.f;
+        }
+
+        time = AdjustTimeToFitRange(time, loop);
+        const std::vector<unsigned int>& active = mask.GetTracks(*this, slot);
+        unsigned int size = static_cast<unsigned int>(active.size());
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            const TransformTrack& track = tracks[active[i]];
+            math::Transform& transform = outPose.LocalTransform(track.boneID);
+            transform = helper::Blend(transform, track.Sample(transform, time, loop), t);
+        }
+        return time;
+    }
 }
\ No newline at end of file
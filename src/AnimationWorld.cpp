@@ -0,0 +1,754 @@
+#include "AnimationWorld.h"
+
+#include <cfloat>
+
+namespace animation
+{
+    typedef jobs::TaskGraph::AFFINITY AFFINITY;
+
+    AnimationWorld::~AnimationWorld()
+    {
+        Clear();
+    }
+
+    void AnimationWorld::Initialize(const skin::Skeleton& skeleton, const StateMachine& stateMachine,
+        const std::vector<skin::AnimatedMesh>& meshes, jobs::JobSystem* jobSystem)
+    {
+        Clear();
+        mSkeleton = &skeleton;
+        mStateMachine = &stateMachine;
+        mMeshes = &meshes;
+        mJobSystem = jobSystem;
+        mJointCount = skeleton.restPose.Size();
+
+        mArenaCount = jobSystem != nullptr && jobSystem->ThreadCount() > 0 ? jobSystem->ThreadCount() : 1;
+        mArenas.reset(new memory::FrameArena[mArenaCount]);
+
+        mHasCamera = false;
+        mUpdateRateLevels = { { 0.25f, 1 }, { 0.1f, 2 }, { 0.04f, 4 }, { 0.0f, 8 } };
+        mSkeletonLODLevels.clear();
+        mSignificanceSettings = SignificanceSettings();
+        mSignificanceScale = 1.0f;
+        mUpdateMilliseconds = 0.0f;
+
+        // Sphere around the bind pose box of every mesh
+        math::vec3 minimum(FLT_MAX, FLT_MAX, FLT_MAX);
+        math::vec3 maximum(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (const skin::AnimatedMesh& mesh : meshes)
+        {
+            for (const math::vec3& position : mesh.mPositions)
+            {
+                for (unsigned int axis = 0; axis < 3; ++axis)
+                {
+                    minimum.v[axis] = fminf(minimum.v[axis], position.v[axis]);
+                    maximum.v[axis] = fmaxf(maximum.v[axis], position.v[axis]);
+                }
+            }
+        }
+        if (minimum.v[0] > maximum.v[0])
+        {
+            mDefaultBounds = math::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+        else
+        {
+            math::vec3 center = (minimum + maximum) * 0.5f;
+            mDefaultBounds = math::vec4(center.v[0], center.v[1], center.v[2], math::length(maximum - center) * BoundsPadding);
+        }
+        mLODMasks.clear();
+        for (const skin::SkeletonLOD& lod : skeleton.lods)
+        {
+            mLODMasks.push_back(lod.mask);
+            stateMachine.BindMask(mLODMasks.back());
+        }
+
+        mTaskGraph = jobs::TaskGraph();
+        mTaskGraph.AddStage("advance", {}, { STATE }, &AnimationWorld::AdvanceStage);
+        mTaskGraph.AddStage("sample", { STATE }, { SAMPLED_POSES }, &AnimationWorld::SampleStage);
+        mTaskGraph.AddStage("blend", { SAMPLED_POSES }, { BLENDED_POSE }, &AnimationWorld::BlendStage);
+        mTaskGraph.AddStage("ik", { BLENDED_POSE }, { SOLVED_POSE }, &AnimationWorld::IKStage);
+        mTaskGraph.AddStage("palette", { SOLVED_POSE }, { PALETTE }, &AnimationWorld::PaletteStage);
+        mTaskGraph.AddStage("skin", { PALETTE }, { SKINNED_VERTICES }, &AnimationWorld::SkinStage);
+        mTaskGraph.AddStage("upload", { SKINNED_VERTICES }, { VERTEX_BUFFERS }, &AnimationWorld::UploadStage, AFFINITY::MAIN_THREAD);
+        mTaskGraph.Compile();
+    }
+
+    void AnimationWorld::Clear()
+    {
+        EndUpdate();
+        for (SkinnedInstance& skinned : mSkinned)
+        {
+            for (gfx::VertexBuffer<math::vec3>* buffer : skinned.positionBuffers)
+            {
+                delete buffer;
+            }
+            for (gfx::VertexBuffer<math::vec3>* buffer : skinned.normalBuffers)
+            {
+                delete buffer;
+            }
+        }
+
+        mSlotToIndex.clear();
+        mSlotGenerations.clear();
+        mFreeSlots.clear();
+        mIndexToSlot.clear();
+        mStates.clear();
+        mModels.clear();
+        mBlendWeights.clear();
+        mSkinned.clear();
+        mPoses.clear();
+        mBlendPoses.clear();
+        for (std::vector<math::mat4>& palettes : mPalettes)
+        {
+            palettes.clear();
+        }
+        mUpdatePeriods.clear();
+        mUpdatePhases.clear();
+        mPendingTime.clear();
+        for (std::vector<math::mat4>& history : mPaletteHistory)
+        {
+            history.clear();
+        }
+        mLatestHistory.clear();
+        mSkeletonLODs.clear();
+        mImportances.clear();
+        mSignificances.clear();
+        mBounds.clear();
+        mVisible.clear();
+        mSkinPaths.clear();
+        mInstanceCosts.clear();
+        mStageStarts.clear();
+    }
+
+    void AnimationWorld::Reserve(unsigned int capacity)
+    {
+        EndUpdate();
+        mSlotToIndex.reserve(capacity);
+        mSlotGenerations.reserve(capacity);
+        mIndexToSlot.reserve(capacity);
+        mStates.reserve(capacity);
+        mModels.reserve(capacity);
+        mBlendWeights.reserve(capacity);
+        mSkinned.reserve(capacity);
+        mPoses.reserve(capacity * mJointCount);
+        mBlendPoses.reserve(capacity);
+        for (std::vector<math::mat4>& palettes : mPalettes)
+        {
+            palettes.reserve(capacity * mJointCount);
+        }
+        mUpdatePeriods.reserve(capacity);
+        mUpdatePhases.reserve(capacity);
+        mPendingTime.reserve(capacity);
+        for (std::vector<math::mat4>& history : mPaletteHistory)
+        {
+            history.reserve(capacity * mJointCount);
+        }
+        mLatestHistory.reserve(capacity);
+        mSkeletonLODs.reserve(capacity);
+        mImportances.reserve(capacity);
+        mSignificances.reserve(capacity);
+        mBounds.reserve(capacity);
+        mVisible.reserve(capacity);
+        mSkinPaths.reserve(capacity);
+        mInstanceCosts.reserve(capacity);
+        mStageStarts.reserve(capacity);
+    }
+
+    WorldHandle AnimationWorld::Add(const math::Transform& model, const StateMachineInstance& state, bool cpuSkinned)
+    {
+        EndUpdate();
+
+        unsigned int index = Size();
+        unsigned int slot;
+        if (!mFreeSlots.empty())
+        {
+            slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<unsigned int>(mSlotToIndex.size());
+            mSlotToIndex.push_back(0);
+            mSlotGenerations.push_back(0);
+        }
+        mSlotToIndex[slot] = index;
+
+        mIndexToSlot.push_back(slot);
+        mStates.push_back(state);
+        mModels.push_back(model);
+        mBlendWeights.push_back(1.0f);
+
+        const std::vector<math::Transform>& restPose = mSkeleton->restPose.joints;
+        mPoses.insert(mPoses.end(), restPose.begin(), restPose.end());
+        mBlendPoses.push_back(nullptr);
+        for (std::vector<math::mat4>& palettes : mPalettes)
+        {
+            palettes.resize(palettes.size() + mJointCount);
+        }
+
+        // New instances start at full rate, the next camera update moves them to their level
+        mUpdatePeriods.push_back(1);
+        mUpdatePhases.push_back(static_cast<unsigned char>(mNextPhase++));
+        mPendingTime.push_back(0.0f);
+        for (std::vector<math::mat4>& history : mPaletteHistory)
+        {
+            history.resize(history.size() + mJointCount);
+        }
+        mLatestHistory.push_back(NoHistory);
+        mSkeletonLODs.push_back(0);
+        mImportances.push_back(1.0f);
+        mSignificances.push_back(1.0f);
+        mBounds.push_back(mDefaultBounds);
+        mVisible.push_back(1);
+        mSkinPaths.push_back(static_cast<unsigned char>(cpuSkinned ? SKIN_PATH::CPU : SKIN_PATH::GPU));
+        mInstanceCosts.push_back(0.0f);
+        mStageStarts.emplace_back();
+
+        mSkinned.emplace_back();
+        if (cpuSkinned)
+        {
+            SkinnedInstance& skinned = mSkinned.back();
+            unsigned int meshCount = static_cast<unsigned int>(mMeshes->size());
+            for (unsigned int buffer = 0; buffer < WorldFrameBuffers; ++buffer)
+            {
+                skinned.positions[buffer].resize(meshCount);
+                skinned.normals[buffer].resize(meshCount);
+                for (unsigned int i = 0; i < meshCount; ++i)
+                {
+                    const skin::AnimatedMesh& mesh = (*mMeshes)[i];
+                    skinned.positions[buffer][i].assign(mesh.mPositions.begin(), mesh.mPositions.end());
+                    skinned.normals[buffer][i].assign(mesh.mNormals.begin(), mesh.mNormals.end());
+                }
+            }
+
+            skinned.positionBuffers.resize(meshCount);
+            skinned.normalBuffers.resize(meshCount);
+            for (unsigned int i = 0; i < meshCount; ++i)
+            {
+                const skin::AnimatedMesh& mesh = (*mMeshes)[i];
+                skinned.positionBuffers[i] = new gfx::VertexBuffer<math::vec3>({});
+                skinned.positionBuffers[i]->Upload(mesh.mPositions.data(), static_cast<unsigned int>(mesh.mPositions.size()));
+                skinned.normalBuffers[i] = new gfx::VertexBuffer<math::vec3>({});
+                skinned.normalBuffers[i]->Upload(mesh.mNormals.data(), static_cast<unsigned int>(mesh.mNormals.size()));
+            }
+        }
+
+        WorldHandle handle;
+        handle.slot = slot;
+        handle.generation = mSlotGenerations[slot];
+        return handle;
+    }
+
+    void AnimationWorld::Remove(WorldHandle handle)
+    {
+        if (!IsValid(handle))
+        {
+            return;
+        }
+
+        EndUpdate();
+
+        unsigned int index = mSlotToIndex[handle.slot];
+        unsigned int last = Size() - 1;
+
+        SkinnedInstance& removed = mSkinned[index];
+        for (gfx::VertexBuffer<math::vec3>* buffer : removed.positionBuffers)
+        {
+            delete buffer;
+        }
+        for (gfx::VertexBuffer<math::vec3>* buffer : removed.normalBuffers)
+        {
+            delete buffer;
+        }
+
+        // Move the last instance into the hole so the arrays stay packed
+        if (index != last)
+        {
+            unsigned int movedSlot = mIndexToSlot[last];
+            mIndexToSlot[index] = movedSlot;
+            mSlotToIndex[movedSlot] = index;
+            mStates[index] = mStates[last];
+            mModels[index] = mModels[last];
+            mBlendWeights[index] = mBlendWeights[last];
+            mSkinned[index] = std::move(mSkinned[last]);
+
+            memcpy(&mPoses[index * mJointCount], &mPoses[last * mJointCount], sizeof(math::Transform) * mJointCount);
+            mBlendPoses[index] = mBlendPoses[last];
+            for (std::vector<math::mat4>& palettes : mPalettes)
+            {
+                memcpy(&palettes[index * mJointCount], &palettes[last * mJointCount], sizeof(math::mat4) * mJointCount);
+            }
+
+            mUpdatePeriods[index] = mUpdatePeriods[last];
+            mUpdatePhases[index] = mUpdatePhases[last];
+            mPendingTime[index] = mPendingTime[last];
+            for (std::vector<math::mat4>& history : mPaletteHistory)
+            {
+                memcpy(&history[index * mJointCount], &history[last * mJointCount], sizeof(math::mat4) * mJointCount);
+            }
+            mLatestHistory[index] = mLatestHistory[last];
+            mSkeletonLODs[index] = mSkeletonLODs[last];
+            mImportances[index] = mImportances[last];
+            mSignificances[index] = mSignificances[last];
+            mBounds[index] = mBounds[last];
+            mVisible[index] = mVisible[last];
+            mSkinPaths[index] = mSkinPaths[last];
+            mInstanceCosts[index] = mInstanceCosts[last];
+        }
+
+        mIndexToSlot.pop_back();
+        mStates.pop_back();
+        mModels.pop_back();
+        mBlendWeights.pop_back();
+        mSkinned.pop_back();
+        mPoses.resize(last * mJointCount);
+        mBlendPoses.pop_back();
+        for (std::vector<math::mat4>& palettes : mPalettes)
+        {
+            palettes.resize(last * mJointCount);
+        }
+        mUpdatePeriods.pop_back();
+        mUpdatePhases.pop_back();
+        mPendingTime.pop_back();
+        for (std::vector<math::mat4>& history : mPaletteHistory)
+        {
+            history.resize(last * mJointCount);
+        }
+        mLatestHistory.pop_back();
+        mSkeletonLODs.pop_back();
+        mImportances.pop_back();
+        mSignificances.pop_back();
+        mBounds.pop_back();
+        mVisible.pop_back();
+        mSkinPaths.pop_back();
+        mInstanceCosts.pop_back();
+        mStageStarts.pop_back();
+
+        ++mSlotGenerations[handle.slot];
+        mFreeSlots.push_back(handle.slot);
+    }
+
+    bool AnimationWorld::IsValid(WorldHandle handle) const
+    {
+        return handle.slot < mSlotGenerations.size() && mSlotGenerations[handle.slot] == handle.generation;
+    }
+
+    unsigned int AnimationWorld::GetIndex(WorldHandle handle) const
+    {
+        return mSlotToIndex[handle.slot];
+    }
+
+    void AnimationWorld::SetIKSolver(IKSolver solver, void* user)
+    {
+        mIKSolver = solver;
+        mIKUser = user;
+    }
+
+    void AnimationWorld::SetCamera(const math::mat4& view, const math::mat4& projection)
+    {
+        mHasCamera = true;
+        mView = view;
+        mProjection = projection;
+        mFrustum = math::FrustumFromMatrix(projection * view);
+    }
+
+    void AnimationWorld::SetUpdateRateLevels(const std::vector<UpdateRateLevel>& levels, UPDATE_RATE_BLEND blend)
+    {
+        mUpdateRateLevels = levels;
+        mUpdateRateBlend = blend;
+    }
+
+    void AnimationWorld::SetSkeletonLODLevels(const std::vector<SkeletonLODLevel>& levels)
+    {
+        mSkeletonLODLevels = levels;
+    }
+
+    void AnimationWorld::SetSignificanceSettings(const SignificanceSettings& settings)
+    {
+        mSignificanceSettings = settings;
+        mSignificanceScale = 1.0f;
+    }
+
+    void AnimationWorld::SetImportance(unsigned int index, float importance)
+    {
+        mImportances[index] = importance;
+    }
+
+    void AnimationWorld::SetBounds(unsigned int index, const math::vec3& center, float radius)
+    {
+        mBounds[index] = math::vec4(center.v[0], center.v[1], center.v[2], radius);
+    }
+
+    void AnimationWorld::SelectLevels()
+    {
+        // Adjust the scale by how far off the last update was, the square root damps the correction
+        // so one slow frame does not drop everybody to the lowest level
+        float budget = mSignificanceSettings.budgetMilliseconds;
+        if (budget > 0.0f && mUpdateMilliseconds > 0.0f)
+        {
+            float correction = sqrtf(budget / mUpdateMilliseconds);
+            correction = correction < 0.5f ? 0.5f : (correction > 2.0f ? 2.0f : correction);
+            mSignificanceScale *= correction;
+            mSignificanceScale = mSignificanceScale < 0.0001f ? 0.0001f : (mSignificanceScale > 1.0f ? 1.0f : mSignificanceScale);
+        }
+        else if (budget <= 0.0f)
+        {
+            mSignificanceScale = 1.0f;
+        }
+
+        // Projected height of the bounding sphere relative to the screen height
+        float yScale = mProjection.cols[1].v[1];
+        for (unsigned int i = 0; i < Size(); ++i)
+        {
+            const math::Transform& model = mModels[i];
+            const math::vec4& bounds = mBounds[i];
+            math::vec3 center = math::TransformPoint(model, math::vec3(bounds.v[0], bounds.v[1], bounds.v[2]));
+            float scale = fmaxf(fabsf(model.scale.v[0]), fmaxf(fabsf(model.scale.v[1]), fabsf(model.scale.v[2])));
+            float radius = bounds.v[3] * scale;
+
+            bool visible = math::Intersects(mFrustum, center, radius);
+            mVisible[i] = visible ? 1 : 0;
+            float screenSize = 0.0f;
+            if (visible)
+            {
+                float depth = -math::TransformPoint(mView, center).v[2];
+                screenSize = depth > radius ? radius * yScale / depth : 1.0f;
+            }
+            float significance = screenSize * mImportances[i] * mSignificanceScale;
+            mSignificances[i] = significance;
+
+            // Instances are sampled once before they can be held or interpolated
+            bool sampled = mLatestHistory[i] != NoHistory;
+            bool wasStopped = mSkinPaths[i] == static_cast<unsigned char>(SKIN_PATH::NONE);
+            SKIN_PATH path = SKIN_PATH::GPU;
+            if (sampled && (!visible || significance < mSignificanceSettings.updateMinSignificance))
+            {
+                path = SKIN_PATH::NONE;
+            }
+            else if (!mSkinned[i].positionBuffers.empty() && significance >= mSignificanceSettings.cpuSkinningMinSignificance)
+            {
+                path = SKIN_PATH::CPU;
+            }
+            mSkinPaths[i] = static_cast<unsigned char>(path);
+
+            // Resync on the first frame back instead of waiting for the period or interpolating
+            // from the pose the instance stopped in
+            if (wasStopped && path != SKIN_PATH::NONE)
+            {
+                mLatestHistory[i] = NoHistory;
+                sampled = false;
+            }
+
+            unsigned int period = 1;
+            for (const UpdateRateLevel& level : mUpdateRateLevels)
+            {
+                period = level.period;
+                if (significance >= level.minSignificance)
+                {
+                    break;
+                }
+            }
+            period = period < 1 ? 1 : (period > MaxUpdatePeriod ? MaxUpdatePeriod : period);
+            mUpdatePeriods[i] = static_cast<unsigned char>(sampled ? period : 1);
+
+            unsigned int lod = 0;
+            for (const SkeletonLODLevel& level : mSkeletonLODLevels)
+            {
+                lod = level.lod;
+                if (significance >= level.minSignificance)
+                {
+                    break;
+                }
+            }
+            unsigned int lodCount = static_cast<unsigned int>(mLODMasks.size());
+            lod = lod < lodCount ? lod : (lodCount > 0 ? lodCount - 1 : 0);
+            mSkeletonLODs[i] = static_cast<unsigned char>(lod < MaxSkeletonLOD ? lod : MaxSkeletonLOD);
+        }
+    }
+
+    void AnimationWorld::KickOrRun(float deltaTime, bool wait)
+    {
+        unsigned int count = Size();
+        if (count == 0)
+        {
+            return;
+        }
+
+        mDeltaTime = deltaTime;
+        // Periods only change between updates so every stage agrees on which instances are due
+        ++mFrame;
+        if (mHasCamera)
+        {
+            SelectLevels();
+        }
+
+        // No update is in flight, last frame's scratch memory can go
+        for (unsigned int i = 0; i < mArenaCount; ++i)
+        {
+            mArenas[i].Reset();
+        }
+
+        // A few ranges per thread leaves room for stealing when instances cost different amounts
+        unsigned int threadCount = mJobSystem != nullptr ? mJobSystem->ThreadCount() : 1;
+        unsigned int grainSize = count / (threadCount * 4);
+        if (grainSize == 0)
+        {
+            grainSize = 1;
+        }
+
+        if (wait)
+        {
+            mUploadBuffer = mWriteBuffer;
+            mTaskGraph.Run(mJobSystem, count, grainSize, this);
+            FinishUpdate();
+        }
+        else
+        {
+            mTaskGraph.Kick(mJobSystem, count, grainSize, this);
+            mUpdateInFlight = true;
+        }
+    }
+
+    void AnimationWorld::Update(float deltaTime)
+    {
+        EndUpdate();
+        KickOrRun(deltaTime, true);
+    }
+
+    void AnimationWorld::BeginUpdate(float deltaTime)
+    {
+        EndUpdate();
+        KickOrRun(deltaTime, false);
+    }
+
+    void AnimationWorld::EndUpdate()
+    {
+        if (!mUpdateInFlight)
+        {
+            return;
+        }
+
+        mTaskGraph.Wait();
+        mUpdateInFlight = false;
+        FinishUpdate();
+    }
+
+    void AnimationWorld::FinishUpdate()
+    {
+        mReadBuffer.store(mWriteBuffer, std::memory_order_release);
+        mWriteBuffer = (mWriteBuffer + 1) % WorldFrameBuffers;
+
+        float milliseconds = 0.0f;
+        for (float cost : mInstanceCosts)
+        {
+            milliseconds += cost;
+        }
+        mUpdateMilliseconds = milliseconds;
+    }
+
+    void AnimationWorld::Upload()
+    {
+        // The workers only write mWriteBuffer, the published frame can be read while they run
+        mUploadBuffer = mReadBuffer.load(std::memory_order_acquire);
+        mTaskGraph.RunMainStages(Size(), this);
+    }
+
+    void AnimationWorld::AdvanceStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        world->mStageStarts[index] = std::chrono::steady_clock::now();
+
+        // Skipped frames add up so a low rate instance keeps the same speed. Stopped instances
+        // keep their playback time current, nothing else is done for them.
+        float deltaTime = world->mPendingTime[index] + world->mDeltaTime;
+        bool stopped = world->mSkinPaths[index] == static_cast<unsigned char>(SKIN_PATH::NONE);
+        if (!world->IsDue(index) && !stopped)
+        {
+            world->mPendingTime[index] = deltaTime;
+            return;
+        }
+
+        world->mPendingTime[index] = 0.0f;
+        world->mStateMachine->Update(world->mStates[index], deltaTime);
+    }
+
+    void AnimationWorld::SampleStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        world->mBlendPoses[index] = nullptr;
+        if (!world->IsDue(index))
+        {
+            return;
+        }
+
+        const StateMachineInstance& state = world->mStates[index];
+
+        // Only transitions need a second pose
+        PoseView blendPose = world->GetPose(index);
+        blendPose.joints = nullptr;
+        if (state.previousState != InvalidState)
+        {
+            blendPose.joints = world->GetArena().Allocate<math::Transform>(world->mJointCount);
+        }
+        world->mBlendPoses[index] = blendPose.joints;
+
+        unsigned int lod = world->mSkeletonLODs[index];
+        if (lod > 0)
+        {
+            world->mBlendWeights[index] = world->mStateMachine->SampleLayers(state, world->GetPose(index), blendPose, world->mLODMasks[lod]);
+        }
+        else
+        {
+            world->mBlendWeights[index] = world->mStateMachine->SampleLayers(state, world->GetPose(index), blendPose);
+        }
+    }
+
+    void AnimationWorld::BlendStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        float weight = world->mBlendWeights[index];
+        if (weight < 1.0f && world->mBlendPoses[index] != nullptr)
+        {
+            PoseView pose = world->GetPose(index);
+            PoseView blendPose = pose;
+            blendPose.joints = world->mBlendPoses[index];
+            Blend(pose, blendPose, pose, weight);
+        }
+    }
+
+    void AnimationWorld::IKStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        if (world->mIKSolver != nullptr && world->IsDue(index))
+        {
+            world->mIKSolver(world->mIKUser, *world->mSkeleton, world->GetPose(index), world->mModels[index]);
+        }
+    }
+
+    void AnimationWorld::PaletteStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        unsigned int jointCount = world->mJointCount;
+        unsigned int updateFrame = world->GetUpdateFrame(index);
+        unsigned char& latest = world->mLatestHistory[index];
+
+        if (world->IsDue(index))
+        {
+            memory::FrameArena& arena = world->GetArena();
+            size_t mark = arena.Mark();
+            math::Transform* globals = arena.Allocate<math::Transform>(jointCount);
+
+            unsigned char previous = latest;
+            latest = latest == NoHistory ? 0 : 1 - latest;
+            math::mat4* palette = &world->mPaletteHistory[latest][index * jointCount];
+            const math::mat4* inverseBindPose = world->mSkeleton->inverseBindPose.data();
+            unsigned int lod = world->mSkeletonLODs[index];
+            if (lod == 0)
+            {
+                world->GetPose(index).GetGlobalTransforms(globals);
+                for (unsigned int i = 0; i < jointCount; ++i)
+                {
+                    palette[i] = MatrixFromTransform(globals[i]) * inverseBindPose[i];
+                }
+            }
+            else
+            {
+                const skin::SkeletonLOD& skeletonLOD = world->mSkeleton->lods[lod];
+                const unsigned int* active = skeletonLOD.joints.data();
+                unsigned int activeCount = static_cast<unsigned int>(skeletonLOD.joints.size());
+                world->GetPose(index).GetGlobalTransforms(globals, active, activeCount);
+                for (unsigned int j = 0; j < activeCount; ++j)
+                {
+                    unsigned int i = active[j];
+                    palette[i] = MatrixFromTransform(globals[i]) * inverseBindPose[i];
+                }
+
+                // Dropped joints move with their active ancestor, GPU skinning keeps the full influences
+                const unsigned int* remap = skeletonLOD.remap.data();
+                for (unsigned int i = 0; i < jointCount; ++i)
+                {
+                    if (remap[i] != i)
+                    {
+                        palette[i] = palette[remap[i]];
+                    }
+                }
+            }
+            arena.Rewind(mark);
+
+            // A new instance has nothing to interpolate from yet
+            if (previous == NoHistory)
+            {
+                memcpy(&world->mPaletteHistory[1][index * jointCount], palette, sizeof(math::mat4) * jointCount);
+            }
+        }
+
+        const math::mat4* newest = &world->mPaletteHistory[latest][index * jointCount];
+        math::mat4* palette = &world->mPalettes[world->mWriteBuffer][index * jointCount];
+        unsigned int period = world->mUpdatePeriods[index];
+        if (period == 1 || world->mUpdateRateBlend == UPDATE_RATE_BLEND::HOLD ||
+            world->mSkinPaths[index] == static_cast<unsigned char>(SKIN_PATH::NONE))
+        {
+            memcpy(palette, newest, sizeof(math::mat4) * jointCount);
+            return;
+        }
+
+        // Catch up with the newest palette over the period until the next one is sampled
+        const math::mat4* older = &world->mPaletteHistory[1 - latest][index * jointCount];
+        float t = static_cast<float>(updateFrame) / static_cast<float>(period);
+        for (unsigned int i = 0; i < jointCount; ++i)
+        {
+            palette[i] = older[i] * (1.0f - t) + newest[i] * t;
+        }
+    }
+
+    void AnimationWorld::SkinStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        SkinnedInstance& skinned = world->mSkinned[index];
+        unsigned int buffer = world->mWriteBuffer;
+        unsigned int previousBuffer = (buffer + WorldFrameBuffers - 1) % WorldFrameBuffers;
+        SKIN_PATH path = static_cast<SKIN_PATH>(world->mSkinPaths[index]);
+
+        // Stopped instances keep drawing the way they did
+        skinned.cpuSkinned[buffer] = path == SKIN_PATH::NONE ? skinned.cpuSkinned[previousBuffer] : path == SKIN_PATH::CPU;
+        skinned.fresh[buffer] = false;
+        if (path == SKIN_PATH::CPU)
+        {
+            // A held palette did not change, neither did the vertices the upload stage already has,
+            // unless the instance was drawn on the GPU in between
+            bool interpolated = world->mUpdateRateBlend == UPDATE_RATE_BLEND::INTERPOLATE && world->mUpdatePeriods[index] > 1;
+            skinned.fresh[buffer] = interpolated || world->IsDue(index) || !skinned.cpuSkinned[previousBuffer];
+        }
+
+        if (skinned.fresh[buffer])
+        {
+            const math::mat4* palette = &world->mPalettes[buffer][index * world->mJointCount];
+            const std::vector<skin::AnimatedMesh>& meshes = *world->mMeshes;
+            for (unsigned int i = 0; i < meshes.size(); ++i)
+            {
+                meshes[i].CPUSkin(palette, skinned.positions[buffer][i], skinned.normals[buffer][i], world->mSkeletonLODs[index]);
+            }
+        }
+
+        // Last worker stage of the instance
+        std::chrono::duration<float, std::milli> cost = std::chrono::steady_clock::now() - world->mStageStarts[index];
+        world->mInstanceCosts[index] = cost.count();
+    }
+
+    void AnimationWorld::UploadStage(void* context, unsigned int index)
+    {
+        AnimationWorld* world = static_cast<AnimationWorld*>(context);
+        SkinnedInstance& skinned = world->mSkinned[index];
+
+        unsigned int buffer = world->mUploadBuffer;
+        if (!skinned.fresh[buffer])
+        {
+            return;
+        }
+
+        for (unsigned int i = 0; i < skinned.positionBuffers.size(); ++i)
+        {
+            skinned.positionBuffers[i]->Upload(skinned.positions[buffer][i]);
+            skinned.normalBuffers[i]->Upload(skinned.normals[buffer][i]);
+        }
+    }
+}
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "Animation.h"
+#include "Camera.h"
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "Skinning.h"
+#include "StateMachine.h"
+#include "TaskGraph.h"
+
+namespace animation
+{
+    // Animation results are double buffered, workers write one copy while the render thread reads the other
+    constexpr unsigned int WorldFrameBuffers = 2;
+
+    // Stable reference to an instance, stays valid while other instances are added or removed
+    struct WorldHandle
+    {
+        unsigned int slot = (unsigned int)-1;
+        unsigned int generation = 0;
+    };
+
+    // Instances less significant than minSignificance use the next level
+    struct UpdateRateLevel
+    {
+        float minSignificance;
+        // Sampled every period frames
+        unsigned int period;
+    };
+
+    struct SkeletonLODLevel
+    {
+        float minSignificance;
+        // Index into the skeleton's lods
+        unsigned int lod;
+    };
+
+    // What low rate instances show on the frames they are not sampled
+    enum class UPDATE_RATE_BLEND
+    {
+        HOLD,       // keep the last palette, CPU skinning is skipped as well
+        INTERPOLATE // lerp between the last two palettes, one sampling period behind
+    };
+
+    // How an instance is skinned, picked by the update from its significance
+    enum class SKIN_PATH : unsigned char
+    {
+        CPU,  // skinned by the workers and uploaded, instances added with cpuSkinned only
+        GPU,  // only the palette is built, the render thread skins in the vertex shader
+        NONE  // pose, palette and vertices are kept, only playback time advances
+    };
+
+    // Significance is the fraction of the screen height an instance's bounds cover times its importance,
+    // 0 outside of the view frustum. Under a budget it is scaled down until the workers fit in it again,
+    // which pushes instances to lower levels, starting with the least significant ones.
+    struct SignificanceSettings
+    {
+        // CPU time of the worker stages per update, summed over threads, 0 disables the budget
+        float budgetMilliseconds = 0.0f;
+        // CPU skinned instances less significant than this are skinned on the GPU
+        float cpuSkinningMinSignificance = 0.1f;
+        // Instances less significant than this are not updated at all
+        float updateMinSignificance = 0.005f;
+    };
+
+    // Runs after blending and before the palette is built, may modify the pose in place.
+    // Called from worker threads.
+    typedef void (*IKSolver)(void* user, const skin::Skeleton& skeleton, const PoseView& pose, const math::Transform& model);
+
+    // Instances sharing a skeleton, a state machine and a set of meshes, stored as parallel arrays.
+    // Instances are densely packed in [0, Size()), every pose and palette lives in one contiguous
+    // slab so the update streams through memory. Removing swaps the last instance into the hole,
+    // handles go through a slot table to find where their instance currently is. Temporary data
+    // (blend poses, global transforms) comes from per-thread frame arenas, a steady frame does not allocate.
+    //
+    // Update runs the stages below as a task graph, every worker stage of one instance runs
+    // back to back on the same thread while other threads work on other instances:
+    //   advance -> sample -> blend -> IK -> palette -> skin -> upload (render thread)
+    // Update runs them synchronously. BeginUpdate/EndUpdate let the render thread draw the
+    // previous frame while the workers compute the next one:
+    //   EndUpdate()        frame fence, publishes the frame the workers finished
+    //   BeginUpdate(dt)    queues the next frame, returns right away
+    //   Upload()           uploads the published frame while the workers run
+    //   Render             reads GetPalette and the vertex buffers, never waits on the workers
+    class AnimationWorld
+    {
+    public:
+        // Resources the update stages read and write
+        enum RESOURCE : unsigned int
+        {
+            STATE,
+            SAMPLED_POSES,
+            BLENDED_POSE,
+            SOLVED_POSE,
+            PALETTE,
+            SKINNED_VERTICES,
+            VERTEX_BUFFERS
+        };
+
+        AnimationWorld() = default;
+        AnimationWorld(const AnimationWorld&) = delete;
+        AnimationWorld& operator=(const AnimationWorld&) = delete;
+        ~AnimationWorld();
+
+        // The world keeps references to everything passed in here, jobSystem may be null
+        void Initialize(const skin::Skeleton& skeleton, const StateMachine& stateMachine,
+            const std::vector<skin::AnimatedMesh>& meshes, jobs::JobSystem* jobSystem);
+        // Releases the instances and their GL buffers, render thread only
+        void Clear();
+        void Reserve(unsigned int capacity);
+
+        // Render thread only, CPU skinned instances create their vertex buffers here.
+        // Both wait for an update in flight before touching the instances.
+        WorldHandle Add(const math::Transform& model, const StateMachineInstance& state, bool cpuSkinned);
+        void Remove(WorldHandle handle);
+
+        bool IsValid(WorldHandle handle) const;
+        // Dense index of a valid handle, changes when other instances are removed
+        unsigned int GetIndex(WorldHandle handle) const;
+
+        // Optional, the IK stage does nothing until a solver is set
+        void SetIKSolver(IKSolver solver, void* user);
+
+        // Temporal and skeletal LOD. The next update culls the instance bounds against the view frustum
+        // and picks every instance's sampling period, skeleton LOD and skinning path from its
+        // significance. Instances outside the frustum only advance their playback time and are sampled
+        // again as soon as they come back into view. Without a camera every instance is fully
+        // sampled every frame.
+        void SetCamera(const math::mat4& view, const math::mat4& projection);
+        // Sorted from the most significant down, the last level should have a minSignificance of 0
+        void SetUpdateRateLevels(const std::vector<UpdateRateLevel>& levels, UPDATE_RATE_BLEND blend);
+        // Skeletal LOD, picked the same way. Instances use LOD 0 until levels are set.
+        // Lower LODs only sample, build palettes for and skin with their active joints.
+        void SetSkeletonLODLevels(const std::vector<SkeletonLODLevel>& levels);
+        void SetSignificanceSettings(const SignificanceSettings& settings);
+        // Gameplay weight of an instance's significance, 1 by default
+        void SetImportance(unsigned int index, float importance);
+        // Model space bounding sphere, must hold every pose the instance plays. Defaults to the
+        // bind pose bounds of the meshes with some padding for limbs moving out of them.
+        void SetBounds(unsigned int index, const math::vec3& center, float radius);
+
+        // Must be called from the render thread, the upload stage runs on the calling thread
+        // while workers are still busy with later instances
+        void Update(float deltaTime);
+
+        void BeginUpdate(float deltaTime);
+        void EndUpdate();
+        void Upload();
+
+        inline unsigned int Size() const
+        {
+            return static_cast<unsigned int>(mStates.size());
+        }
+
+        inline unsigned int JointCount() const
+        {
+            return mJointCount;
+        }
+
+        // Not safe while an update is in flight, call EndUpdate first
+        inline StateMachineInstance& GetState(unsigned int index)
+        {
+            return mStates[index];
+        }
+
+        inline PoseView GetPose(unsigned int index)
+        {
+            PoseView view;
+            view.joints = &mPoses[index * mJointCount];
+            view.parents = mSkeleton->restPose.parents.data();
+            view.size = mJointCount;
+            return view;
+        }
+
+        // The render thread may read these while an update is in flight
+        inline math::Transform& GetModel(unsigned int index)
+        {
+            return mModels[index];
+        }
+
+        inline unsigned int GetUpdatePeriod(unsigned int index) const
+        {
+            return mUpdatePeriods[index];
+        }
+
+        inline unsigned int GetSkeletonLOD(unsigned int index) const
+        {
+            return mSkeletonLODs[index];
+        }
+
+        inline float GetSignificance(unsigned int index) const
+        {
+            return mSignificances[index];
+        }
+
+        // As of the last update, only meaningful once a camera is set
+        inline bool IsVisible(unsigned int index) const
+        {
+            return mVisible[index] != 0;
+        }
+
+        inline SKIN_PATH GetSkinPath(unsigned int index) const
+        {
+            return static_cast<SKIN_PATH>(mSkinPaths[index]);
+        }
+
+        // Whether the published frame of the instance is in its vertex buffers, false when the
+        // instance has none or was skinned on the GPU
+        inline bool IsCPUSkinned(unsigned int index) const
+        {
+            return mSkinned[index].cpuSkinned[mReadBuffer.load(std::memory_order_acquire)];
+        }
+
+        // CPU time the worker stages of the last finished update took, summed over threads
+        inline float GetUpdateMilliseconds() const
+        {
+            return mUpdateMilliseconds;
+        }
+
+        // Latest published skinning matrices, JointCount() of them
+        inline const math::mat4* GetPalette(unsigned int index) const
+        {
+            return &mPalettes[mReadBuffer.load(std::memory_order_acquire)][index * mJointCount];
+        }
+
+        inline gfx::VertexBuffer<math::vec3>* GetPositionBuffer(unsigned int index, unsigned int mesh) const
+        {
+            return mSkinned[index].positionBuffers[mesh];
+        }
+
+        inline gfx::VertexBuffer<math::vec3>* GetNormalBuffer(unsigned int index, unsigned int mesh) const
+        {
+            return mSkinned[index].normalBuffers[mesh];
+        }
+
+    private:
+        // Outputs of CPU skinning, empty for GPU skinned instances
+        struct SkinnedInstance
+        {
+            // One entry per mesh and frame buffer
+            std::vector<std::vector<math::vec3>> positions[WorldFrameBuffers];
+            std::vector<std::vector<math::vec3>> normals[WorldFrameBuffers];
+            std::vector<gfx::VertexBuffer<math::vec3>*> positionBuffers;
+            std::vector<gfx::VertexBuffer<math::vec3>*> normalBuffers;
+            // Whether the buffer was skinned by its last update, held instances skip skinning
+            bool fresh[WorldFrameBuffers] = {};
+            // Whether the frame in the buffer is to be drawn with the CPU skinned vertices
+            bool cpuSkinned[WorldFrameBuffers] = {};
+        };
+
+        // Scales the bind pose bounds of the meshes into the default instance bounds
+        constexpr static float BoundsPadding = 1.25f;
+        // Periods, phases and LODs are stored as bytes
+        constexpr static unsigned int MaxUpdatePeriod = 255;
+        constexpr static unsigned int MaxSkeletonLOD = 255;
+        // mLatestHistory of an instance that was never sampled
+        constexpr static unsigned char NoHistory = 2;
+
+        // Arena of the calling thread, reset at the start of every update
+        inline memory::FrameArena& GetArena()
+        {
+            unsigned int thread = mJobSystem != nullptr ? mJobSystem->ThreadIndex() : 0;
+            return mArenas[thread < mArenaCount ? thread : 0];
+        }
+
+        void KickOrRun(float deltaTime, bool wait);
+        // Publishes the frame the workers finished and sums up its cost
+        void FinishUpdate();
+        // Picks update rates and skeleton LODs from the screen size of every instance
+        void SelectLevels();
+
+        // Frames since the instance was last sampled, 0 on the frames it is sampled
+        inline unsigned int GetUpdateFrame(unsigned int index) const
+        {
+            return (mFrame + mUpdatePhases[index]) % mUpdatePeriods[index];
+        }
+
+        // Whether the instance is sampled this update
+        inline bool IsDue(unsigned int index) const
+        {
+            return mSkinPaths[index] != static_cast<unsigned char>(SKIN_PATH::NONE) && GetUpdateFrame(index) == 0;
+        }
+
+        static void AdvanceStage(void* context, unsigned int index);
+        static void SampleStage(void* context, unsigned int index);
+        static void BlendStage(void* context, unsigned int index);
+        static void IKStage(void* context, unsigned int index);
+        static void PaletteStage(void* context, unsigned int index);
+        static void SkinStage(void* context, unsigned int index);
+        static void UploadStage(void* context, unsigned int index);
+
+        const skin::Skeleton* mSkeleton = nullptr;
+        const StateMachine* mStateMachine = nullptr;
+        const std::vector<skin::AnimatedMesh>* mMeshes = nullptr;
+        jobs::JobSystem* mJobSystem = nullptr;
+        jobs::TaskGraph mTaskGraph;
+        IKSolver mIKSolver = nullptr;
+        void* mIKUser = nullptr;
+        float mDeltaTime = 0.0f;
+        unsigned int mJointCount = 0;
+
+        std::vector<UpdateRateLevel> mUpdateRateLevels;
+        UPDATE_RATE_BLEND mUpdateRateBlend = UPDATE_RATE_BLEND::INTERPOLATE;
+        bool mHasCamera = false;
+        math::mat4 mView;
+        math::mat4 mProjection;
+        math::Frustum mFrustum;
+        // Center and radius of the default bounds
+        math::vec4 mDefaultBounds;
+        std::vector<SkeletonLODLevel> mSkeletonLODLevels;
+        SignificanceSettings mSignificanceSettings;
+        // Multiplies every significance, lowered while the workers are over budget
+        float mSignificanceScale = 1.0f;
+        float mUpdateMilliseconds = 0.0f;
+        // Copies of the skeleton's LOD masks, bound to every clip so workers can share them
+        std::vector<JointMask> mLODMasks;
+        unsigned int mFrame = 0;
+        // Spreads low rate instances over the frames of their period
+        unsigned int mNextPhase = 0;
+
+        // Handle slot -> dense index, generations invalidate handles of removed instances
+        std::vector<unsigned int> mSlotToIndex;
+        std::vector<unsigned int> mSlotGenerations;
+        std::vector<unsigned int> mFreeSlots;
+
+        // Dense arrays, all indexed by instance
+        std::vector<unsigned int> mIndexToSlot;
+        std::vector<StateMachineInstance> mStates;
+        std::vector<math::Transform> mModels;
+        // Weight of the pose when blending with the blend pose, 1 when no transition is running
+        std::vector<float> mBlendWeights;
+        std::vector<SkinnedInstance> mSkinned;
+        // Slabs of JointCount() entries per instance
+        std::vector<math::Transform> mPoses;
+        std::vector<math::mat4> mPalettes[WorldFrameBuffers];
+        // Pose of the state being blended out, frame arena memory, null when not blending
+        std::vector<math::Transform*> mBlendPoses;
+
+        std::vector<unsigned char> mUpdatePeriods;
+        std::vector<unsigned char> mUpdatePhases;
+        // Time not yet applied to instances that were skipped
+        std::vector<float> mPendingTime;
+        // Last two computed palettes of every instance, mLatestHistory tells which slab holds the newest
+        std::vector<math::mat4> mPaletteHistory[2];
+        std::vector<unsigned char> mLatestHistory;
+        std::vector<unsigned char> mSkeletonLODs;
+        std::vector<float> mImportances;
+        std::vector<float> mSignificances;
+        std::vector<math::vec4> mBounds;
+        std::vector<unsigned char> mVisible;
+        std::vector<unsigned char> mSkinPaths;
+        // Worker time spent on each instance by the last update
+        std::vector<float> mInstanceCosts;
+        std::vector<std::chrono::steady_clock::time_point> mStageStarts;
+
+        std::unique_ptr<memory::FrameArena[]> mArenas;
+        unsigned int mArenaCount = 0;
+
+        // Buffer the workers write to, only changes while no update is in flight
+        unsigned int mWriteBuffer = 1;
+        std::atomic<unsigned int> mReadBuffer{ 0 };
+        // Buffer the upload stage reads from
+        unsigned int mUploadBuffer = 0;
+        bool mUpdateInFlight = false;
+    };
+}
@@ -0,0 +1,308 @@
+#include "AssetManager.h"
+#include "Cooked.h"
+#include "gltf.h"
+#include "utils.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace assets
+{
+    namespace
+    {
+        bool EndsWith(const std::string& text, const char* suffix)
+        {
+            size_t length = strlen(suffix);
+            return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+        }
+
+        bool LoadCharacter(const std::string& path, Character& character, jobs::JobSystem& jobSystem)
+        {
+            if (EndsWith(path, ".cooked"))
+            {
+                return cooked::Load(path.c_str(), character.skeleton, character.clips, character.meshes);
+            }
+
+            // The cooker writes <source>.cooked, only used while it was cooked from this very source
+            // by this loader version
+            std::string cookedPath = path + ".cooked";
+            uint64_t sourceHash = cooked::GetSourceHash(cookedPath.c_str());
+            if (sourceHash != 0 && sourceHash == gltf::HashSource(path.c_str()) &&
+                cooked::Load(cookedPath.c_str(), character.skeleton, character.clips, character.meshes))
+            {
+                return true;
+            }
+
+            cgltf_data* data = gltf::LoadGLTFFile(path.c_str(), &jobSystem);
+            if (data == nullptr)
+            {
+                return false;
+            }
+            gltf::LoadScene(character.skeleton, character.clips, character.meshes, data, jobSystem, path.c_str());
+            gltf::FreeGLTFFile(data);
+            return true;
+        }
+
+        struct Image
+        {
+            ~Image()
+            {
+                stbi_image_free(pixels);
+            }
+
+            unsigned char* pixels = nullptr;
+            int width = 0;
+            int height = 0;
+            int channels = 0;
+        };
+
+        struct ShaderSource
+        {
+            std::string vertex;
+            std::string fragment;
+        };
+    }
+
+    AssetManager::~AssetManager()
+    {
+        Shutdown();
+    }
+
+    void AssetManager::Initialize(unsigned int threadCount)
+    {
+        if (threadCount == 0)
+        {
+            threadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+        }
+        mStop = false;
+        mThread = std::thread(&AssetManager::Run, this, threadCount);
+    }
+
+    void AssetManager::Shutdown()
+    {
+        if (mThread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStop = true;
+            }
+            mCondition.notify_one();
+            mThread.join();
+        }
+
+        // Nothing is uploaded past this point, waiters still get their callback
+        std::vector<std::unique_ptr<Request>> requests;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            requests.swap(mDecoded);
+            for (std::unique_ptr<Request>& request : mQueued)
+            {
+                requests.push_back(std::move(request));
+            }
+            mQueued.clear();
+        }
+        for (std::unique_ptr<Request>& request : requests)
+        {
+            request->complete(false);
+        }
+        mPending = 0;
+        mAssets.clear();
+    }
+
+    CharacterHandle AssetManager::RequestCharacter(const std::string& path, std::function<void(Character&)> prepare)
+    {
+        std::string key = "character:" + path;
+        if (CharacterHandle existing = Find<Character>(key))
+        {
+            return existing;
+        }
+
+        CharacterHandle asset = Create<Character>(key, path);
+        std::shared_ptr<std::unique_ptr<Character>> character = std::make_shared<std::unique_ptr<Character>>();
+        std::unique_ptr<Request> request(new Request());
+        request->decode = [this, path, prepare, character]()
+        {
+            *character = std::make_unique<Character>();
+            if (!LoadCharacter(path, **character, mJobSystem))
+            {
+                std::cout << "Could not load character " << path << std::endl;
+                return false;
+            }
+            if (prepare)
+            {
+                prepare(**character);
+            }
+            return true;
+        };
+        request->complete = [asset, character](bool decoded)
+        {
+            if (decoded)
+            {
+                for (skin::AnimatedMesh& mesh : (*character)->meshes)
+                {
+                    mesh.UpdateGPUBuffers();
+                }
+            }
+            Complete(*asset, decoded ? std::move(*character) : nullptr);
+        };
+        Queue(std::move(request));
+        return asset;
+    }
+
+    TextureHandle AssetManager::RequestTexture(const std::string& path)
+    {
+        std::string key = "texture:" + path;
+        if (TextureHandle existing = Find<gfx::Texture>(key))
+        {
+            return existing;
+        }
+
+        TextureHandle asset = Create<gfx::Texture>(key, path);
+        std::shared_ptr<Image> image = std::make_shared<Image>();
+        std::unique_ptr<Request> request(new Request());
+        request->decode = [path, image]()
+        {
+            image->pixels = stbi_load(path.c_str(), &image->width, &image->height, &image->channels, 4);
+            if (image->pixels == nullptr)
+            {
+                std::cout << "Could not load texture " << path << std::endl;
+                return false;
+            }
+            return true;
+        };
+        request->complete = [asset, image](bool decoded)
+        {
+            std::unique_ptr<gfx::Texture> texture;
+            if (decoded)
+            {
+                texture = std::make_unique<gfx::Texture>(image->pixels, image->width, image->height, image->channels);
+            }
+            Complete(*asset, std::move(texture));
+        };
+        Queue(std::move(request));
+        return asset;
+    }
+
+    ShaderHandle AssetManager::RequestShader(const std::string& vertexPath, const std::string& fragmentPath)
+    {
+        std::string path = vertexPath + ";" + fragmentPath;
+        std::string key = "shader:" + path;
+        if (ShaderHandle existing = Find<gfx::Shader>(key))
+        {
+            return existing;
+        }
+
+        ShaderHandle asset = Create<gfx::Shader>(key, path);
+        std::shared_ptr<ShaderSource> source = std::make_shared<ShaderSource>();
+        std::unique_ptr<Request> request(new Request());
+        request->decode = [vertexPath, fragmentPath, source]()
+        {
+            source->vertex = utils::ReadFile(vertexPath.c_str());
+            source->fragment = utils::ReadFile(fragmentPath.c_str());
+            if (source->vertex.empty() || source->fragment.empty())
+            {
+                std::cout << "Could not load shader " << vertexPath << ", " << fragmentPath << std::endl;
+                return false;
+            }
+            return true;
+        };
+        request->complete = [asset, source](bool decoded)
+        {
+            std::unique_ptr<gfx::Shader> shader;
+            if (decoded)
+            {
+                shader = std::make_unique<gfx::Shader>(source->vertex, source->fragment);
+                if (shader->handle == 0)
+                {
+                    shader.reset();
+                }
+            }
+            Complete(*asset, std::move(shader));
+        };
+        Queue(std::move(request));
+        return asset;
+    }
+
+    unsigned int AssetManager::Update(unsigned int maxCompletions)
+    {
+        std::vector<std::unique_ptr<Request>> completed;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mDecoded.size() <= maxCompletions)
+            {
+                completed.swap(mDecoded);
+            }
+            else
+            {
+                // Oldest first, the rest waits for the next frames
+                std::move(mDecoded.begin(), mDecoded.begin() + maxCompletions, std::back_inserter(completed));
+                mDecoded.erase(mDecoded.begin(), mDecoded.begin() + maxCompletions);
+            }
+        }
+
+        for (std::unique_ptr<Request>& request : completed)
+        {
+            request->complete(request->decoded);
+        }
+        unsigned int count = static_cast<unsigned int>(completed.size());
+        mPending -= count;
+        return count;
+    }
+
+    void AssetManager::Queue(std::unique_ptr<Request> request)
+    {
+        ++mPending;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueued.push_back(std::move(request));
+        }
+        mCondition.notify_one();
+    }
+
+    void AssetManager::Decode(void* data, unsigned int, unsigned int)
+    {
+        std::unique_ptr<Request> request(static_cast<Request*>(data));
+        request->decoded = request->decode();
+        AssetManager& manager = *request->manager;
+        std::lock_guard<std::mutex> lock(manager.mMutex);
+        manager.mDecoded.push_back(std::move(request));
+    }
+
+    void AssetManager::Run(unsigned int threadCount)
+    {
+        // The loader thread is worker 0 of its own job system. It only hands requests to the other
+        // workers, so a new request is picked up right away whatever they are busy decoding.
+        mJobSystem.Initialize(threadCount + 1);
+        std::atomic<unsigned int> inFlight{ 0 };
+
+        std::vector<std::unique_ptr<Request>> batch;
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true)
+        {
+            mCondition.wait(lock, [this]() { return mStop || !mQueued.empty(); });
+            if (mStop)
+            {
+                break;
+            }
+
+            batch.swap(mQueued);
+            lock.unlock();
+
+            // Requests decode side by side, each one is published as soon as it is done. A character
+            // spreads further over the workers in LoadScene.
+            for (std::unique_ptr<Request>& request : batch)
+            {
+                request->manager = this;
+                mJobSystem.Submit(Decode, request.release(), 0, 1, inFlight);
+            }
+            batch.clear();
+
+            lock.lock();
+        }
+        lock.unlock();
+
+        mJobSystem.Wait(inFlight);
+        mJobSystem.Shutdown();
+    }
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Animation.h"
+#include "Gfx.h"
+#include "JobSystem.h"
+#include "Skinning.h"
+
+// co_await support needs C++20, the rest of the manager builds as C++17
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define ANIMATION_ASSET_COROUTINES
+#endif
+
+// Asynchronous loading. Requests return a handle at once and are decoded on a loader thread with its
+// own job system, so loads never queue behind the frame's jobs. Only the GL work, uploading meshes and
+// textures and compiling shaders, is left for Update on the render thread, which then marks the
+// assets READY and runs their callbacks.
+namespace assets
+{
+    enum class ASSET_STATE
+    {
+        LOADING,
+        READY,
+        FAILED
+    };
+
+    // What one model file holds
+    struct Character
+    {
+        skin::Skeleton skeleton;
+        std::vector<animation::ClipHandle> clips;
+        std::vector<skin::AnimatedMesh> meshes;
+    };
+
+    class AssetManager;
+
+    // The state may be polled from any thread, the value may only be used once it is READY
+    template <typename T>
+    class Asset
+    {
+    public:
+        typedef std::function<void(Asset<T>&)> Callback;
+
+        inline ASSET_STATE GetState() const
+        {
+            return mState.load(std::memory_order_acquire);
+        }
+
+        inline bool IsReady() const
+        {
+            return GetState() == ASSET_STATE::READY;
+        }
+
+        inline const std::string& GetPath() const
+        {
+            return mPath;
+        }
+
+        inline T& Get()
+        {
+            return *mValue;
+        }
+
+        inline const T& Get() const
+        {
+            return *mValue;
+        }
+
+    private:
+        friend class AssetManager;
+
+        std::string mPath;
+        std::atomic<ASSET_STATE> mState{ ASSET_STATE::LOADING };
+        std::unique_ptr<T> mValue;
+        // Render thread only
+        std::vector<Callback> mCallbacks;
+    };
+
+    typedef std::shared_ptr<Asset<Character>> CharacterHandle;
+    typedef std::shared_ptr<Asset<gfx::Texture>> TextureHandle;
+    typedef std::shared_ptr<Asset<gfx::Shader>> ShaderHandle;
+
+#ifdef ANIMATION_ASSET_COROUTINES
+    template <typename T>
+    struct AssetAwaiter;
+
+    // Fire and forget return type for coroutines awaiting assets, runs until its first co_await
+    // when called and is resumed by Update from there on
+    struct LoadTask
+    {
+        struct promise_type
+        {
+            LoadTask get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+#endif
+
+    class AssetManager
+    {
+    public:
+        AssetManager() = default;
+        AssetManager(const AssetManager&) = delete;
+        AssetManager& operator=(const AssetManager&) = delete;
+        ~AssetManager();
+
+        // Starts the loader thread and threadCount threads decoding the requests it hands them, 0 leaves
+        // half the hardware threads to the frame
+        void Initialize(unsigned int threadCount = 0);
+        // Waits for the loads in flight, every asset not completed yet fails and runs its callbacks
+        void Shutdown();
+
+        // Requests, WhenLoaded and Update are called from the render thread. Requesting an asset that
+        // is still referenced returns the same handle.
+        //
+        // .cooked files are read with cooked::Load, anything else as glTF unless the cooker's
+        // <path>.cooked next to it is up to date with it. prepare runs on the loader thread once the
+        // character is decoded, to build LODs before anything can see it.
+        CharacterHandle RequestCharacter(const std::string& path, std::function<void(Character&)> prepare = nullptr);
+        TextureHandle RequestTexture(const std::string& path);
+        ShaderHandle RequestShader(const std::string& vertexPath, const std::string& fragmentPath);
+
+        // Runs callback from Update once the asset is READY or FAILED, right away if it already is
+        template <typename T>
+        void WhenLoaded(const std::shared_ptr<Asset<T>>& asset, typename Asset<T>::Callback callback)
+        {
+            if (asset->GetState() != ASSET_STATE::LOADING)
+            {
+                callback(*asset);
+                return;
+            }
+            asset->mCallbacks.push_back(std::move(callback));
+        }
+
+#ifdef ANIMATION_ASSET_COROUTINES
+        // co_await manager.Loaded(handle) resumes inside Update once the asset completed and returns
+        // it, check its state for failures
+        template <typename T>
+        AssetAwaiter<T> Loaded(const std::shared_ptr<Asset<T>>& asset)
+        {
+            return AssetAwaiter<T>{ *this, asset };
+        }
+#endif
+
+        // Uploads what the loader finished, at most maxCompletions assets so a burst of loads is spread
+        // over frames, and runs their callbacks. Returns the number of assets completed.
+        unsigned int Update(unsigned int maxCompletions = ~0u);
+
+        // Requests Update has not completed yet
+        inline unsigned int Pending() const
+        {
+            return mPending;
+        }
+
+    private:
+        struct Request
+        {
+            // Loader threads, returns false on failure
+            std::function<bool()> decode;
+            // Render thread, uploads when decoding succeeded and completes the asset
+            std::function<void(bool)> complete;
+            bool decoded = false;
+            AssetManager* manager = nullptr;
+        };
+
+        template <typename T>
+        static void Complete(Asset<T>& asset, std::unique_ptr<T> value)
+        {
+            asset.mValue = std::move(value);
+            asset.mState.store(asset.mValue ? ASSET_STATE::READY : ASSET_STATE::FAILED, std::memory_order_release);
+            // Callbacks may wait on other assets or request new ones
+            std::vector<typename Asset<T>::Callback> callbacks;
+            callbacks.swap(asset.mCallbacks);
+            for (typename Asset<T>::Callback& callback : callbacks)
+            {
+                callback(asset);
+            }
+        }
+
+        template <typename T>
+        std::shared_ptr<Asset<T>> Find(const std::string& key)
+        {
+            auto it = mAssets.find(key);
+            return it != mAssets.end() ? std::static_pointer_cast<Asset<T>>(it->second.lock()) : nullptr;
+        }
+
+        template <typename T>
+        std::shared_ptr<Asset<T>> Create(const std::string& key, const std::string& path)
+        {
+            std::shared_ptr<Asset<T>> asset = std::make_shared<Asset<T>>();
+            asset->mPath = path;
+            mAssets[key] = asset;
+            return asset;
+        }
+
+        void Queue(std::unique_ptr<Request> request);
+        void Run(unsigned int threadCount);
+        // Job decoding one request, data owns it until it is moved to mDecoded
+        static void Decode(void* data, unsigned int begin, unsigned int end);
+
+        std::thread mThread;
+        jobs::JobSystem mJobSystem; // owned by the loader thread
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        std::vector<std::unique_ptr<Request>> mQueued;
+        std::vector<std::unique_ptr<Request>> mDecoded;
+        bool mStop = false;
+
+        // Render thread only
+        std::unordered_map<std::string, std::weak_ptr<void>> mAssets;
+        unsigned int mPending = 0;
+    };
+
+#ifdef ANIMATION_ASSET_COROUTINES
+    template <typename T>
+    struct AssetAwaiter
+    {
+        AssetManager& manager;
+        std::shared_ptr<Asset<T>> asset;
+
+        bool await_ready() const
+        {
+            return asset->GetState() != ASSET_STATE::LOADING;
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            manager.WhenLoaded(asset, [coroutine](Asset<T>&) { coroutine.resume(); });
+        }
+
+        Asset<T>& await_resume() const
+        {
+            return *asset;
+        }
+    };
+#endif
+}
@@ -0,0 +1,655 @@
+#include "BlendSpace.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+
+namespace animation
+{
+    namespace
+    {
+        struct Circle
+        {
+            float x;
+            float y;
+            float radiusSq;
+        };
+
+        struct Edge
+        {
+            unsigned int a;
+            unsigned int b;
+        };
+
+        struct WorkTriangle
+        {
+            unsigned int points[3];
+            Circle circumcircle;
+        };
+
+        Circle Circumcircle(float ax, float ay, float bx, float by, float cx, float cy)
+        {
+            Circle result;
+            const float d = 2.0f * (ax * (by - cy) + bx * (cy - ay) + cx * (ay - by));
+            if (fabsf(d) < math::MY_EPSILON)
+            {
+                // Degenerate triangle, make sure it is always considered bad
+                result.x = 0.0f;
+                result.y = 0.0f;
+                result.radiusSq = FLT_MAX;
+                return result;
+            }
+
+            const float a2 = ax * ax + ay * ay;
+            const float b2 = bx * bx + by * by;
+            const float c2 = cx * cx + cy * cy;
+            result.x = (a2 * (by - cy) + b2 * (cy - ay) + c2 * (ay - by)) / d;
+            result.y = (a2 * (cx - bx) + b2 * (ax - cx) + c2 * (bx - ax)) / d;
+            result.radiusSq = (ax - result.x) * (ax - result.x) + (ay - result.y) * (ay - result.y);
+            return result;
+        }
+
+        // Half plane nx * x + ny * y + d >= 0
+        struct HalfPlane
+        {
+            float nx;
+            float ny;
+            float d;
+        };
+
+        // Clips the box by every half plane, true if anything is left
+        bool Overlaps(float minX, float minY, float maxX, float maxY, const HalfPlane* planes, unsigned int planeCount)
+        {
+            // A box clipped by at most three half planes has at most seven corners
+            float polygon[2][8][2] = { { { minX, minY }, { maxX, minY }, { maxX, maxY }, { minX, maxY } } };
+            unsigned int count = 4;
+            unsigned int current = 0;
+            for (unsigned int p = 0; p < planeCount && count > 0; ++p)
+            {
+                const HalfPlane& plane = planes[p];
+                const float (*in)[2] = polygon[current];
+                float (*out)[2] = polygon[1 - current];
+                unsigned int outCount = 0;
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    const float* a = in[i];
+                    const float* b = in[(i + 1) % count];
+                    const float da = plane.nx * a[0] + plane.ny * a[1] + plane.d;
+                    const float db = plane.nx * b[0] + plane.ny * b[1] + plane.d;
+                    if (da >= -math::MY_EPSILON)
+                    {
+                        out[outCount][0] = a[0];
+                        out[outCount][1] = a[1];
+                        ++outCount;
+                    }
+                    if ((da >= -math::MY_EPSILON) != (db >= -math::MY_EPSILON))
+                    {
+                        const float t = da / (da - db);
+                        out[outCount][0] = a[0] + (b[0] - a[0]) * t;
+                        out[outCount][1] = a[1] + (b[1] - a[1]) * t;
+                        ++outCount;
+                    }
+                }
+                count = outCount;
+                current = 1 - current;
+            }
+            return count > 0;
+        }
+    }
+
+    unsigned int BlendSpace2D::AddSample(unsigned int clip, float x, float y)
+    {
+        Point point;
+        point.clip = clip;
+        point.x = x;
+        point.y = y;
+        mPoints.push_back(point);
+        return static_cast<unsigned int>(mPoints.size() - 1);
+    }
+
+    bool BlendSpace2D::Build(const std::vector<ClipHandle>& clips, unsigned int gridResolution)
+    {
+        mClips = clips;
+        mNormalizedPoints.clear();
+        mTriangles.clear();
+        mCells.clear();
+        mCellTriangles.clear();
+        mHullEdges.clear();
+        mCellEdges.clear();
+        mDurations.clear();
+
+        if (mPoints.empty())
+        {
+            std::cout << "Blend space has no samples\n";
+            return false;
+        }
+
+        unsigned int pointCount = static_cast<unsigned int>(mPoints.size());
+        mDurations.resize(pointCount);
+        float maxX = mPoints[0].x;
+        float maxY = mPoints[0].y;
+        mMinX = mPoints[0].x;
+        mMinY = mPoints[0].y;
+        for (unsigned int i = 0; i < pointCount; ++i)
+        {
+            if (mPoints[i].clip >= clips.size() || !clips[mPoints[i].clip])
+            {
+                std::cout << "Blend space sample refers to a missing clip\n";
+                return false;
+            }
+            mDurations[i] = clips[mPoints[i].clip]->GetDuration();
+            mMinX = std::min(mMinX, mPoints[i].x);
+            mMinY = std::min(mMinY, mPoints[i].y);
+            maxX = std::max(maxX, mPoints[i].x);
+            maxY = std::max(maxY, mPoints[i].y);
+        }
+
+        // Triangulate in normalized space so that axes with different units weigh the same
+        mScaleX = (maxX - mMinX) > math::MY_EPSILON ? 1.0f / (maxX - mMinX) : 1.0f;
+        mScaleY = (maxY - mMinY) > math::MY_EPSILON ? 1.0f / (maxY - mMinY) : 1.0f;
+        mNormalizedPoints = mPoints;
+        for (Point& point : mNormalizedPoints)
+        {
+            point.x = (point.x - mMinX) * mScaleX;
+            point.y = (point.y - mMinY) * mScaleY;
+        }
+
+        Triangulate();
+        FindHullEdges();
+        BuildGrid(std::max(gridResolution, 1u));
+        return true;
+    }
+
+    // Bowyer-Watson, the sample count is small and this only runs at load time
+    void BlendSpace2D::Triangulate()
+    {
+        unsigned int pointCount = static_cast<unsigned int>(mNormalizedPoints.size());
+        if (pointCount < 3)
+        {
+            return;
+        }
+
+        // Super triangle enclosing the unit square, its vertices live past the real points
+        std::vector<Point> vertices = mNormalizedPoints;
+        Point super[3] = { { 0, -10.0f, -10.0f }, { 0, 10.0f, -10.0f }, { 0, 0.5f, 10.0f } };
+        vertices.push_back(super[0]);
+        vertices.push_back(super[1]);
+        vertices.push_back(super[2]);
+
+        auto makeTriangle = [&vertices](unsigned int a, unsigned int b, unsigned int c)
+        {
+            WorkTriangle triangle;
+            triangle.points[0] = a;
+            triangle.points[1] = b;
+            triangle.points[2] = c;
+            triangle.circumcircle = Circumcircle(vertices[a].x, vertices[a].y, vertices[b].x, vertices[b].y,
+                vertices[c].x, vertices[c].y);
+            return triangle;
+        };
+
+        std::vector<WorkTriangle> triangles;
+        triangles.push_back(makeTriangle(pointCount, pointCount + 1, pointCount + 2));
+
+        std::vector<Edge> polygon;
+        std::vector<WorkTriangle> kept;
+        for (unsigned int i = 0; i < pointCount; ++i)
+        {
+            const float px = vertices[i].x;
+            const float py = vertices[i].y;
+            polygon.clear();
+            kept.clear();
+
+            for (const WorkTriangle& triangle : triangles)
+            {
+                const float dx = px - triangle.circumcircle.x;
+                const float dy = py - triangle.circumcircle.y;
+                if (dx * dx + dy * dy <= triangle.circumcircle.radiusSq)
+                {
+                    for (unsigned int e = 0; e < 3; ++e)
+                    {
+                        Edge edge = { triangle.points[e], triangle.points[(e + 1) % 3] };
+                        polygon.push_back(edge);
+                    }
+                }
+                else
+                {
+                    kept.push_back(triangle);
+                }
+            }
+
+            // Edges shared by two bad triangles are interior to the hole
+            for (unsigned int e = 0; e < polygon.size(); ++e)
+            {
+                bool shared = false;
+                for (unsigned int f = 0; f < polygon.size(); ++f)
+                {
+                    if (e != f && ((polygon[e].a == polygon[f].b && polygon[e].b == polygon[f].a) ||
+                        (polygon[e].a == polygon[f].a && polygon[e].b == polygon[f].b)))
+                    {
+                        shared = true;
+                        break;
+                    }
+                }
+
+                if (!shared)
+                {
+                    kept.push_back(makeTriangle(polygon[e].a, polygon[e].b, i));
+                }
+            }
+            triangles.swap(kept);
+        }
+
+        for (const WorkTriangle& work : triangles)
+        {
+            if (work.points[0] < pointCount && work.points[1] < pointCount && work.points[2] < pointCount)
+            {
+                AddTriangle(work.points[0], work.points[1], work.points[2]);
+            }
+        }
+    }
+
+    bool BlendSpace2D::AddTriangle(unsigned int i0, unsigned int i1, unsigned int i2)
+    {
+        const Point& a = mNormalizedPoints[i0];
+        const Point& b = mNormalizedPoints[i1];
+        const Point& c = mNormalizedPoints[i2];
+        const float e00 = b.x - a.x;
+        const float e01 = c.x - a.x;
+        const float e10 = b.y - a.y;
+        const float e11 = c.y - a.y;
+        const float det = e00 * e11 - e01 * e10;
+        if (fabsf(det) < math::MY_EPSILON)
+        {
+            return false;
+        }
+
+        Triangle triangle;
+        triangle.points[0] = i0;
+        triangle.points[1] = i1;
+        triangle.points[2] = i2;
+        triangle.originX = a.x;
+        triangle.originY = a.y;
+        triangle.inv00 = e11 / det;
+        triangle.inv01 = -e01 / det;
+        triangle.inv10 = -e10 / det;
+        triangle.inv11 = e00 / det;
+        mTriangles.push_back(triangle);
+        return true;
+    }
+
+    // Edges used by a single triangle, found by sorting the edges of all triangles. The super
+    // triangle can cut thin triangles off the hull, the pockets it leaves are filled so that
+    // the hull is convex.
+    void BlendSpace2D::FindHullEdges()
+    {
+        struct TriangleEdge
+        {
+            unsigned int low;
+            unsigned int high;
+            unsigned int opposite;
+        };
+
+        std::vector<TriangleEdge> edges;
+        edges.reserve(mTriangles.size() * 3);
+        for (const Triangle& triangle : mTriangles)
+        {
+            for (unsigned int e = 0; e < 3; ++e)
+            {
+                const unsigned int a = triangle.points[e];
+                const unsigned int b = triangle.points[(e + 1) % 3];
+                TriangleEdge edge = { std::min(a, b), std::max(a, b), triangle.points[(e + 2) % 3] };
+                edges.push_back(edge);
+            }
+        }
+        std::sort(edges.begin(), edges.end(), [](const TriangleEdge& a, const TriangleEdge& b)
+        {
+            return a.low < b.low || (a.low == b.low && a.high < b.high);
+        });
+
+        // Boundary as point -> next point, the triangles on the left
+        const unsigned int none = static_cast<unsigned int>(-1);
+        std::vector<unsigned int> next(mNormalizedPoints.size(), none);
+        bool simple = true;
+        for (unsigned int i = 0; i < edges.size();)
+        {
+            unsigned int end = i + 1;
+            while (end < edges.size() && edges[end].low == edges[i].low && edges[end].high == edges[i].high)
+            {
+                ++end;
+            }
+
+            if (end - i == 1)
+            {
+                const Point& a = mNormalizedPoints[edges[i].low];
+                const Point& b = mNormalizedPoints[edges[i].high];
+                const Point& c = mNormalizedPoints[edges[i].opposite];
+                const bool left = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > 0.0f;
+                HullEdge edge = { left ? edges[i].low : edges[i].high, left ? edges[i].high : edges[i].low };
+                simple = simple && next[edge.a] == none;
+                next[edge.a] = edge.b;
+                mHullEdges.push_back(edge);
+            }
+            i = end;
+        }
+
+        // A boundary point turning right sits in a pocket, close it with a triangle
+        // unless another point lies inside
+        bool changed = simple;
+        while (changed)
+        {
+            changed = false;
+            for (unsigned int v = 0; v < next.size(); ++v)
+            {
+                const unsigned int u = next[v];
+                const unsigned int w = u == none ? none : next[u];
+                if (w == none || w == v)
+                {
+                    continue;
+                }
+
+                const Point& a = mNormalizedPoints[v];
+                const Point& b = mNormalizedPoints[u];
+                const Point& c = mNormalizedPoints[w];
+                if ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x) > -math::MY_EPSILON)
+                {
+                    continue;
+                }
+
+                bool empty = true;
+                for (unsigned int p = 0; p < mNormalizedPoints.size() && empty; ++p)
+                {
+                    if (p == v || p == u || p == w)
+                    {
+                        continue;
+                    }
+                    const Point& point = mNormalizedPoints[p];
+                    const float d0 = (b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x);
+                    const float d1 = (c.x - b.x) * (point.y - b.y) - (c.y - b.y) * (point.x - b.x);
+                    const float d2 = (a.x - c.x) * (point.y - c.y) - (a.y - c.y) * (point.x - c.x);
+                    empty = !(d0 <= 0.0f && d1 <= 0.0f && d2 <= 0.0f);
+                }
+
+                if (empty && AddTriangle(v, u, w))
+                {
+                    next[v] = w;
+                    next[u] = none;
+                    changed = true;
+                }
+            }
+        }
+
+        if (simple)
+        {
+            mHullEdges.clear();
+            for (unsigned int v = 0; v < next.size(); ++v)
+            {
+                if (next[v] != none)
+                {
+                    HullEdge edge = { v, next[v] };
+                    mHullEdges.push_back(edge);
+                }
+            }
+        }
+    }
+
+    void BlendSpace2D::BuildGrid(unsigned int gridResolution)
+    {
+        mResolution = gridResolution;
+        mCells.resize(gridResolution * gridResolution);
+
+        // Outside the hull the nearest edge of a point lies in the edge's own slab or in the wedge
+        // between the normals of the edge and the one before it at its first point. A cell keeps
+        // the edges whose slab or wedge it overlaps. Border cells also stand for everything past
+        // the unit square, they reach out far enough to cover any sensible parameter.
+        const float far = 1000.0f;
+        std::vector<unsigned int> incoming(mNormalizedPoints.size(), static_cast<unsigned int>(-1));
+        for (unsigned int e = 0; e < mHullEdges.size(); ++e)
+        {
+            incoming[mHullEdges[e].b] = e;
+        }
+
+        const float cellSize = 1.0f / gridResolution;
+        for (unsigned int y = 0; y < gridResolution; ++y)
+        {
+            for (unsigned int x = 0; x < gridResolution; ++x)
+            {
+                Cell& cell = mCells[y * gridResolution + x];
+                cell.first = static_cast<unsigned int>(mCellTriangles.size());
+
+                const float minX = x * cellSize;
+                const float minY = y * cellSize;
+                const float maxX = minX + cellSize;
+                const float maxY = minY + cellSize;
+                for (unsigned int t = 0; t < mTriangles.size(); ++t)
+                {
+                    // Conservative bounding box overlap
+                    const Triangle& triangle = mTriangles[t];
+                    float tMinX = 1.0f, tMinY = 1.0f, tMaxX = 0.0f, tMaxY = 0.0f;
+                    for (unsigned int p = 0; p < 3; ++p)
+                    {
+                        tMinX = std::min(tMinX, mNormalizedPoints[triangle.points[p]].x);
+                        tMinY = std::min(tMinY, mNormalizedPoints[triangle.points[p]].y);
+                        tMaxX = std::max(tMaxX, mNormalizedPoints[triangle.points[p]].x);
+                        tMaxY = std::max(tMaxY, mNormalizedPoints[triangle.points[p]].y);
+                    }
+
+                    if (tMaxX >= minX && tMinX <= maxX && tMaxY >= minY && tMinY <= maxY)
+                    {
+                        mCellTriangles.push_back(t);
+                    }
+                }
+                cell.count = static_cast<unsigned int>(mCellTriangles.size()) - cell.first;
+
+                const float regionMinX = x == 0 ? -far : minX;
+                const float regionMinY = y == 0 ? -far : minY;
+                const float regionMaxX = x == gridResolution - 1 ? 1.0f + far : maxX;
+                const float regionMaxY = y == gridResolution - 1 ? 1.0f + far : maxY;
+                cell.firstEdge = static_cast<unsigned int>(mCellEdges.size());
+                for (unsigned int e = 0; e < mHullEdges.size(); ++e)
+                {
+                    const Point& a = mNormalizedPoints[mHullEdges[e].a];
+                    const Point& b = mNormalizedPoints[mHullEdges[e].b];
+                    const float dx = b.x - a.x;
+                    const float dy = b.y - a.y;
+                    const HalfPlane slab[3] =
+                    {
+                        { dy, -dx, -(dy * a.x - dx * a.y) },
+                        { dx, dy, -(dx * a.x + dy * a.y) },
+                        { -dx, -dy, dx * b.x + dy * b.y }
+                    };
+                    bool overlaps = Overlaps(regionMinX, regionMinY, regionMaxX, regionMaxY, slab, 3);
+
+                    if (!overlaps && incoming[mHullEdges[e].a] != static_cast<unsigned int>(-1))
+                    {
+                        const Point& before = mNormalizedPoints[mHullEdges[incoming[mHullEdges[e].a]].a];
+                        const float inX = a.x - before.x;
+                        const float inY = a.y - before.y;
+                        const HalfPlane wedge[2] =
+                        {
+                            { inX, inY, -(inX * a.x + inY * a.y) },
+                            { -dx, -dy, dx * a.x + dy * a.y }
+                        };
+                        overlaps = Overlaps(regionMinX, regionMinY, regionMaxX, regionMaxY, wedge, 2);
+                    }
+
+                    if (overlaps)
+                    {
+                        mCellEdges.push_back(e);
+                    }
+                }
+                cell.edgeCount = static_cast<unsigned int>(mCellEdges.size()) - cell.firstEdge;
+            }
+        }
+    }
+
+    void BlendSpace2D::Barycentric(const Triangle& triangle, float x, float y, float out[3]) const
+    {
+        const float dx = x - triangle.originX;
+        const float dy = y - triangle.originY;
+        out[1] = triangle.inv00 * dx + triangle.inv01 * dy;
+        out[2] = triangle.inv10 * dx + triangle.inv11 * dy;
+        out[0] = 1.0f - out[1] - out[2];
+    }
+
+    BlendSpace2D::Weights BlendSpace2D::Evaluate(float x, float y) const
+    {
+        Weights result;
+        result.count = 0;
+        if (mNormalizedPoints.empty())
+        {
+            return result;
+        }
+
+        x = (x - mMinX) * mScaleX;
+        y = (y - mMinY) * mScaleY;
+
+        if (mTriangles.empty())
+        {
+            // Not enough samples to triangulate, play the closest one
+            unsigned int closest = 0;
+            float closestDistance = FLT_MAX;
+            for (unsigned int i = 0; i < mNormalizedPoints.size(); ++i)
+            {
+                const float dx = mNormalizedPoints[i].x - x;
+                const float dy = mNormalizedPoints[i].y - y;
+                if (dx * dx + dy * dy < closestDistance)
+                {
+                    closestDistance = dx * dx + dy * dy;
+                    closest = i;
+                }
+            }
+            result.samples[0] = closest;
+            result.weights[0] = 1.0f;
+            result.count = 1;
+            return result;
+        }
+
+        // Clamped only to pick the cell, border cells cover everything past the unit square
+        unsigned int cellX = std::min(static_cast<unsigned int>(std::max(x, 0.0f) * mResolution), mResolution - 1);
+        unsigned int cellY = std::min(static_cast<unsigned int>(std::max(y, 0.0f) * mResolution), mResolution - 1);
+        const Cell& cell = mCells[cellY * mResolution + cellX];
+
+        float weights[3];
+        const Triangle* found = nullptr;
+        for (unsigned int i = 0; i < cell.count; ++i)
+        {
+            const Triangle& triangle = mTriangles[mCellTriangles[cell.first + i]];
+            Barycentric(triangle, x, y, weights);
+            if (weights[0] >= -math::MY_EPSILON && weights[1] >= -math::MY_EPSILON && weights[2] >= -math::MY_EPSILON)
+            {
+                found = &triangle;
+                break;
+            }
+        }
+
+        if (found == nullptr)
+        {
+            // Outside the hull, blend the two ends of the closest point on its nearest edge
+            HullEdge nearest = { 0, 0 };
+            float nearestT = 0.0f;
+            float nearestDistance = FLT_MAX;
+            for (unsigned int i = 0; i < cell.edgeCount; ++i)
+            {
+                const HullEdge& edge = mHullEdges[mCellEdges[cell.firstEdge + i]];
+                const Point& a = mNormalizedPoints[edge.a];
+                const Point& b = mNormalizedPoints[edge.b];
+                const float ex = b.x - a.x;
+                const float ey = b.y - a.y;
+                const float t = std::min(std::max(((x - a.x) * ex + (y - a.y) * ey) / (ex * ex + ey * ey), 0.0f), 1.0f);
+                const float dx = a.x + ex * t - x;
+                const float dy = a.y + ey * t - y;
+                if (dx * dx + dy * dy < nearestDistance)
+                {
+                    nearestDistance = dx * dx + dy * dy;
+                    nearest = edge;
+                    nearestT = t;
+                }
+            }
+
+            if (nearestDistance == FLT_MAX)
+            {
+                return result;
+            }
+            if (1.0f - nearestT > math::MY_EPSILON)
+            {
+                result.samples[result.count] = nearest.a;
+                result.weights[result.count] = 1.0f - nearestT;
+                ++result.count;
+            }
+            if (nearestT > math::MY_EPSILON)
+            {
+                result.samples[result.count] = nearest.b;
+                result.weights[result.count] = nearestT;
+                ++result.count;
+            }
+            return result;
+        }
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            if (weights[i] > math::MY_EPSILON)
+            {
+                result.samples[result.count] = found->points[i];
+                result.weights[result.count] = weights[i];
+                ++result.count;
+            }
+        }
+        return result;
+    }
+
+    float BlendSpace2D::GetDuration(const Weights& weights) const
+    {
+        float duration = 0.0f;
+        for (unsigned int i = 0; i < weights.count; ++i)
+        {
+            duration += mDurations[weights.samples[i]] * weights.weights[i];
+        }
+        return duration;
+    }
+
+    void BlendSpace2D::Sample(const Weights& weights, float normalizedTime, const PoseView& outPose) const
+    {
+        // Every clip after the first one is blended in by its share of the weights so far
+        float accumulated = 0.0f;
+        for (unsigned int i = 0; i < weights.count; ++i)
+        {
+            const Clip& clip = *mClips[mNormalizedPoints[weights.samples[i]].clip];
+            const float time = clip.startTime + normalizedTime * mDurations[weights.samples[i]];
+            accumulated += weights.weights[i];
+            clip.SampleBlended(outPose, time, true, weights.weights[i] / accumulated);
+        }
+    }
+
+    void BlendSpace2D::Sample(const Weights& weights, float normalizedTime, const PoseView& outPose, const JointMask& mask) const
+    {
+        float accumulated = 0.0f;
+        for (unsigned int i = 0; i < weights.count; ++i)
+        {
+            const unsigned int slot = mNormalizedPoints[weights.samples[i]].clip;
+            const Clip& clip = *mClips[slot];
+            const float time = clip.startTime + normalizedTime * mDurations[weights.samples[i]];
+            accumulated += weights.weights[i];
+            clip.SampleBlended(outPose, time, true, weights.weights[i] / accumulated, mask, slot);
+        }
+    }
+
+    void BlendSpace2D::Sample(BlendSpaceInstance& instance, float x, float y, float deltaTime, Pose& outPose) const
+    {
+        Weights weights = Evaluate(x, y);
+        if (weights.count == 0)
+        {
+            return;
+        }
+
+        const float duration = GetDuration(weights);
+        if (duration > 0.0f)
+        {
+            instance.normalizedTime = fmodf(instance.normalizedTime + deltaTime / duration, 1.0f);
+            if (instance.normalizedTime < 0.0f)
+            {
+                instance.normalizedTime += 1.0f;
+            }
+        }
+        Sample(weights, instance.normalizedTime, outPose.View());
+    }
+}
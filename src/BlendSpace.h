@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include "Animation.h"
+
+namespace animation
+{
+    // Per-instance playback of a blend space, every active clip shares this phase
+    struct BlendSpaceInstance
+    {
+        float normalizedTime = 0.0f;
+    };
+
+    // Clips placed in a 2D parameter space, e.g. speed x direction.
+    // Built once at load time: the samples are Delaunay-triangulated and a uniform grid
+    // maps every cell to the few triangles overlapping it and to the hull edges that can be
+    // nearest to a point of the cell outside the hull. Finding the active triangle and its
+    // barycentric weights, or the projection onto the hull, visits a single cell.
+    class BlendSpace2D
+    {
+    public:
+        struct Weights
+        {
+            unsigned int samples[3]; // as returned by AddSample
+            float weights[3];
+            unsigned int count;
+        };
+
+        unsigned int AddSample(unsigned int clip, float x, float y);
+
+        // Triangulates the samples and fills the lookup grid, samples added afterwards are used from
+        // the next Build on. The blend space keeps a reference to the clips it plays.
+        bool Build(const std::vector<ClipHandle>& clips, unsigned int gridResolution = 16);
+
+        // Finds the triangle containing (x, y), points outside the samples hull are projected onto
+        // its nearest edge
+        Weights Evaluate(float x, float y) const;
+
+        // Duration of the blend, weighted so the feet of all blended clips stay in phase
+        float GetDuration(const Weights& weights) const;
+
+        // Blends at most three clips at the same normalized time into outPose. The clips should
+        // animate the same joints, the ones only some of them animate are blended with outPose.
+        void Sample(const Weights& weights, float normalizedTime, const PoseView& outPose) const;
+        // Same as above, only the joints enabled in mask are sampled. Every clip passed to Build must
+        // be bound to mask in the slot matching its index.
+        void Sample(const Weights& weights, float normalizedTime, const PoseView& outPose, const JointMask& mask) const;
+
+        // Advances the shared phase and blends at most three clips into outPose
+        void Sample(BlendSpaceInstance& instance, float x, float y, float deltaTime, Pose& outPose) const;
+
+        inline unsigned int TriangleCount() const
+        {
+            return static_cast<unsigned int>(mTriangles.size());
+        }
+
+    private:
+        struct Point
+        {
+            unsigned int clip;
+            float x;
+            float y;
+        };
+
+        struct Triangle
+        {
+            unsigned int points[3];
+            // Precomputed inverse of the edge matrix, turns a point into barycentric weights
+            float originX;
+            float originY;
+            float inv00, inv01, inv10, inv11;
+        };
+
+        struct Cell
+        {
+            unsigned int first;
+            unsigned int count;
+            unsigned int firstEdge;
+            unsigned int edgeCount;
+        };
+
+        // Edge of a single triangle, from a to b with the hull on its left
+        struct HullEdge
+        {
+            unsigned int a;
+            unsigned int b;
+        };
+
+        void Triangulate();
+        // Returns false for a degenerate triangle
+        bool AddTriangle(unsigned int a, unsigned int b, unsigned int c);
+        void FindHullEdges();
+        void BuildGrid(unsigned int gridResolution);
+        void Barycentric(const Triangle& triangle, float x, float y, float out[3]) const;
+
+        std::vector<Point> mPoints; // as added
+        std::vector<Point> mNormalizedPoints; // of the last Build, in the unit square
+        std::vector<ClipHandle> mClips;
+        std::vector<float> mDurations;
+        std::vector<Triangle> mTriangles;
+        std::vector<Cell> mCells;
+        std::vector<unsigned int> mCellTriangles;
+        std::vector<HullEdge> mHullEdges;
+        std::vector<unsigned int> mCellEdges;
+        unsigned int mResolution = 0;
+        float mMinX = 0.0f;
+        float mMinY = 0.0f;
+        float mScaleX = 1.0f;
+        float mScaleY = 1.0f;
+    };
+}
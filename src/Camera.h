@@ -67,5 +67,50 @@ namespace math
             t.v[0], t.v[1], t.v[2], 1
         );
     }
+
+    // Planes facing inwards as (normal, distance), points p with dot(normal, p) + distance >= 0 are inside
+    struct Frustum
+    {
+        vec4 planes[6];
+    };
+
+    // Extracts the planes of projection * view
+    inline Frustum FrustumFromMatrix(const mat4& viewProjection)
+    {
+        const mat4& m = viewProjection;
+        Frustum result;
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            for (unsigned int side = 0; side < 2; ++side)
+            {
+                float sign = side == 0 ? 1.0f : -1.0f;
+                vec4 plane(m.cols[0].v[3] + sign * m.cols[0].v[i],
+                           m.cols[1].v[3] + sign * m.cols[1].v[i],
+                           m.cols[2].v[3] + sign * m.cols[2].v[i],
+                           m.cols[3].v[3] + sign * m.cols[3].v[i]);
+                float length = sqrtf(plane.v[0] * plane.v[0] + plane.v[1] * plane.v[1] + plane.v[2] * plane.v[2]);
+                if (length > MY_EPSILON)
+                {
+                    plane = vec4(plane.v[0] / length, plane.v[1] / length, plane.v[2] / length, plane.v[3] / length);
+                }
+                result.planes[i * 2 + side] = plane;
+            }
+        }
+        return result;
+    }
+
+    // Conservative, spheres close to a frustum corner may pass without touching it
+    inline bool Intersects(const Frustum& frustum, const vec3& center, float radius)
+    {
+        for (const vec4& plane : frustum.planes)
+        {
+            float distance = plane.v[0] * center.v[0] + plane.v[1] * center.v[1] + plane.v[2] * center.v[2] + plane.v[3];
+            if (distance < -radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
 }
 
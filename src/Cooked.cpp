@@ -0,0 +1,390 @@
+#include "Cooked.h"
+#include "utils.h"
+
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace cooked
+{
+    // Arrays are stored as they are in memory, catch any change to the types they hold
+    static_assert(sizeof(math::vec2) == 8 && sizeof(math::vec3) == 12 && sizeof(math::vec4) == 16, "Bump cooked::Version");
+    static_assert(sizeof(math::ivec4) == 16 && sizeof(math::mat4) == 64, "Bump cooked::Version");
+    static_assert(sizeof(math::Transform) == 40, "Bump cooked::Version");
+    static_assert(sizeof(animation::VectorFrame) == 40 && sizeof(animation::QuaternionFrame) == 52, "Bump cooked::Version");
+    static_assert(std::is_trivially_copyable<math::Transform>::value && std::is_trivially_copyable<math::mat4>::value &&
+        std::is_trivially_copyable<animation::QuaternionFrame>::value, "Cooked arrays are copied bytewise");
+
+    namespace
+    {
+        class Writer
+        {
+        public:
+            Writer()
+                :mBytes(sizeof(Header), 0)
+            {}
+
+            template <typename T>
+            Range Write(const T* data, size_t count)
+            {
+                static_assert(std::is_trivially_copyable<T>::value, "Cooked arrays are copied bytewise");
+                Range range;
+                if (count == 0)
+                {
+                    return range;
+                }
+
+                range.offset = (mBytes.size() + Alignment - 1) & ~(Alignment - 1);
+                range.count = count;
+                mBytes.resize(range.offset + count * sizeof(T), 0);
+                memcpy(mBytes.data() + range.offset, data, count * sizeof(T));
+                return range;
+            }
+
+            template <typename T>
+            Range Write(const std::vector<T>& data)
+            {
+                return Write(data.data(), data.size());
+            }
+
+            template <typename T>
+            Range Write(const utils::Array<T>& data)
+            {
+                return Write(data.data(), data.size());
+            }
+
+            Range Write(const std::string& text)
+            {
+                return Write(text.data(), text.size());
+            }
+
+            bool Save(const char* path, Header& header)
+            {
+                header.size = mBytes.size();
+                memcpy(mBytes.data(), &header, sizeof(Header));
+
+                std::ofstream file(path, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char*>(mBytes.data()), mBytes.size());
+                return file.good();
+            }
+
+        private:
+            std::vector<unsigned char> mBytes;
+        };
+
+        // Bounds checks every range against the mapping, a bad range marks the whole file invalid
+        class Reader
+        {
+        public:
+            Reader(const unsigned char* data, size_t size, LOAD_MODE mode)
+                :mData(data), mSize(size), mMode(mode)
+            {}
+
+            template <typename T>
+            const T* Get(const Range& range)
+            {
+                if (range.count == 0)
+                {
+                    return nullptr;
+                }
+
+                if (range.offset % Alignment != 0 || range.offset > mSize || range.count > (mSize - range.offset) / sizeof(T))
+                {
+                    mValid = false;
+                    return nullptr;
+                }
+                return reinterpret_cast<const T*>(mData + range.offset);
+            }
+
+            template <typename T>
+            void Read(std::vector<T>& out, const Range& range)
+            {
+                const T* data = Get<T>(range);
+                if (data == nullptr)
+                {
+                    out.clear();
+                    return;
+                }
+                out.assign(data, data + range.count);
+            }
+
+            // Views the mapping, or copies out of it with LOAD_MODE::COPY
+            template <typename T>
+            void Read(utils::Array<T>& out, const Range& range)
+            {
+                const T* data = Get<T>(range);
+                size_t count = data != nullptr ? range.count : 0;
+                if (mMode == LOAD_MODE::MAP)
+                {
+                    out = utils::Array<T>::View(data, count);
+                    return;
+                }
+                out = utils::Array<T>();
+                if (count > 0)
+                {
+                    memcpy(out.Resize(count), data, count * sizeof(T));
+                }
+            }
+
+            void Read(std::string& out, const Range& range)
+            {
+                const char* data = Get<char>(range);
+                out.assign(data != nullptr ? data : "", data != nullptr ? range.count : 0);
+            }
+
+            inline bool IsValid() const
+            {
+                return mValid;
+            }
+
+        private:
+            const unsigned char* mData;
+            size_t mSize;
+            LOAD_MODE mMode;
+            bool mValid = true;
+        };
+
+        template <typename T>
+        CurveRecord WriteCurve(Writer& writer, const animation::Track<T>& track)
+        {
+            CurveRecord record;
+            record.frames = writer.Write(track.frames);
+            record.sampledFrames = writer.Write(track.sampledFrames);
+            record.interpolation = static_cast<uint32_t>(track.interpolationKind);
+            return record;
+        }
+
+        template <typename T>
+        void ReadCurve(Reader& reader, animation::Track<T>& track, const CurveRecord& record)
+        {
+            reader.Read(track.frames, record.frames);
+            reader.Read(track.sampledFrames, record.sampledFrames);
+            track.interpolationKind = static_cast<animation::INTERPOLATION>(record.interpolation);
+        }
+
+        // Writes one range per element of data and returns the range of those ranges
+        template <typename T>
+        Range WriteNested(Writer& writer, const std::vector<utils::Array<T>>& data)
+        {
+            std::vector<Range> ranges(data.size());
+            for (size_t i = 0; i < data.size(); ++i)
+            {
+                ranges[i] = writer.Write(data[i]);
+            }
+            return writer.Write(ranges);
+        }
+
+        template <typename T>
+        void ReadNested(Reader& reader, std::vector<utils::Array<T>>& out, const Range& range)
+        {
+            const Range* ranges = reader.Get<Range>(range);
+            out.resize(ranges != nullptr ? range.count : 0);
+            for (size_t i = 0; i < out.size(); ++i)
+            {
+                reader.Read(out[i], ranges[i]);
+            }
+        }
+    }
+
+    bool Save(const char* path, const skin::Skeleton& skeleton, const std::vector<animation::ClipHandle>& clips,
+        const std::vector<skin::AnimatedMesh>& meshes, uint64_t sourceHash, uint64_t optionsHash)
+    {
+        Writer writer;
+        Header header;
+        header.sourceHash = sourceHash;
+        header.optionsHash = optionsHash;
+
+        SkeletonRecord& skeletonRecord = header.skeleton;
+        skeletonRecord.restPose = writer.Write(skeleton.restPose.joints);
+        skeletonRecord.restParents = writer.Write(skeleton.restPose.parents);
+        skeletonRecord.bindPose = writer.Write(skeleton.bindPose.joints);
+        skeletonRecord.bindParents = writer.Write(skeleton.bindPose.parents);
+        skeletonRecord.inverseBindPose = writer.Write(skeleton.inverseBindPose);
+
+        std::vector<Range> jointNames(skeleton.jointNames.size());
+        for (size_t i = 0; i < jointNames.size(); ++i)
+        {
+            jointNames[i] = writer.Write(skeleton.jointNames[i]);
+        }
+        skeletonRecord.jointNames = writer.Write(jointNames);
+
+        std::vector<LODRecord> lods(skeleton.lods.size());
+        for (size_t i = 0; i < lods.size(); ++i)
+        {
+            lods[i].joints = writer.Write(skeleton.lods[i].joints);
+            lods[i].remap = writer.Write(skeleton.lods[i].remap);
+        }
+        skeletonRecord.lods = writer.Write(lods);
+
+        std::vector<ClipRecord> clipRecords(clips.size());
+        for (size_t i = 0; i < clips.size(); ++i)
+        {
+            const animation::Clip& clip = *clips[i];
+            std::vector<TrackRecord> tracks(clip.tracks.size());
+            for (size_t j = 0; j < tracks.size(); ++j)
+            {
+                const animation::TransformTrack& track = clip.tracks[j];
+                tracks[j].boneID = track.boneID;
+                tracks[j].position = WriteCurve(writer, track.position);
+                tracks[j].rotation = WriteCurve(writer, track.rotation);
+                tracks[j].scale = WriteCurve(writer, track.scale);
+            }
+
+            clipRecords[i].name = writer.Write(clip.name);
+            clipRecords[i].tracks = writer.Write(tracks);
+            clipRecords[i].jointToTrack = writer.Write(clip.jointToTrack);
+            clipRecords[i].startTime = clip.startTime;
+            clipRecords[i].endTime = clip.endTime;
+        }
+        header.clips = writer.Write(clipRecords);
+
+        std::vector<MeshRecord> meshRecords(meshes.size());
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            const skin::AnimatedMesh& mesh = meshes[i];
+            MeshRecord& record = meshRecords[i];
+            record.positions = writer.Write(mesh.mPositions);
+            record.normals = writer.Write(mesh.mNormals);
+            record.textureCoordinates = writer.Write(mesh.mTextureCoordinates);
+            record.weights = writer.Write(mesh.mWeights);
+            record.influences = writer.Write(mesh.mInfluences);
+            record.indices = writer.Write(mesh.mIndices);
+            record.lodWeights = WriteNested(writer, mesh.mLODWeights);
+            record.lodInfluences = WriteNested(writer, mesh.mLODInfluences);
+        }
+        header.meshes = writer.Write(meshRecords);
+
+        if (!writer.Save(path, header))
+        {
+            std::cout << "Could not write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t GetSourceHash(const char* path, uint64_t* optionsHash)
+    {
+        utils::MappedFile file;
+        if (!file.Open(path) || file.Size() < sizeof(Header))
+        {
+            return 0;
+        }
+
+        const Header* header = reinterpret_cast<const Header*>(file.Data());
+        if (header->magic != Magic || header->version != Version || header->size != file.Size())
+        {
+            return 0;
+        }
+        if (optionsHash != nullptr)
+        {
+            *optionsHash = header->optionsHash;
+        }
+        return header->sourceHash;
+    }
+
+    bool Load(const char* path, skin::Skeleton& skeleton, std::vector<animation::ClipHandle>& clips,
+        std::vector<skin::AnimatedMesh>& meshes, LOAD_MODE mode)
+    {
+        // Shared by every clip and mesh viewing it, unmapped with the last of them
+        std::shared_ptr<utils::MappedFile> file = std::make_shared<utils::MappedFile>();
+        if (!file->Open(path))
+        {
+            std::cout << "Could not load " << path << std::endl;
+            return false;
+        }
+
+        const Header* header = reinterpret_cast<const Header*>(file->Data());
+        if (file->Size() < sizeof(Header) || header->magic != Magic || header->version != Version || header->size != file->Size())
+        {
+            std::cout << "Invalid or outdated cooked file: " << path << std::endl;
+            return false;
+        }
+
+        Reader reader(file->Data(), file->Size(), mode);
+        std::shared_ptr<const utils::MappedFile> storage = mode == LOAD_MODE::MAP ? file : nullptr;
+
+        skin::Skeleton loadedSkeleton;
+        const SkeletonRecord& skeletonRecord = header->skeleton;
+        reader.Read(loadedSkeleton.restPose.joints, skeletonRecord.restPose);
+        reader.Read(loadedSkeleton.restPose.parents, skeletonRecord.restParents);
+        reader.Read(loadedSkeleton.bindPose.joints, skeletonRecord.bindPose);
+        reader.Read(loadedSkeleton.bindPose.parents, skeletonRecord.bindParents);
+        reader.Read(loadedSkeleton.inverseBindPose, skeletonRecord.inverseBindPose);
+
+        const Range* jointNames = reader.Get<Range>(skeletonRecord.jointNames);
+        loadedSkeleton.jointNames.resize(jointNames != nullptr ? skeletonRecord.jointNames.count : 0);
+        for (size_t i = 0; i < loadedSkeleton.jointNames.size(); ++i)
+        {
+            reader.Read(loadedSkeleton.jointNames[i], jointNames[i]);
+        }
+
+        unsigned int jointCount = loadedSkeleton.restPose.Size();
+        const LODRecord* lods = reader.Get<LODRecord>(skeletonRecord.lods);
+        loadedSkeleton.lods.resize(lods != nullptr ? skeletonRecord.lods.count : 0);
+        for (size_t i = 0; i < loadedSkeleton.lods.size(); ++i)
+        {
+            skin::SkeletonLOD& lod = loadedSkeleton.lods[i];
+            reader.Read(lod.joints, lods[i].joints);
+            reader.Read(lod.remap, lods[i].remap);
+            lod.mask = animation::JointMask(jointCount, lod.joints);
+        }
+
+        std::vector<animation::ClipHandle> loadedClips;
+        const ClipRecord* clipRecords = reader.Get<ClipRecord>(header->clips);
+        for (size_t i = 0; clipRecords != nullptr && i < header->clips.count; ++i)
+        {
+            const ClipRecord& record = clipRecords[i];
+            std::shared_ptr<animation::Clip> clip = std::make_shared<animation::Clip>();
+            reader.Read(clip->name, record.name);
+            reader.Read(clip->jointToTrack, record.jointToTrack);
+            clip->startTime = record.startTime;
+            clip->endTime = record.endTime;
+            clip->storage = storage;
+
+            const TrackRecord* tracks = reader.Get<TrackRecord>(record.tracks);
+            clip->tracks.resize(tracks != nullptr ? record.tracks.count : 0);
+            for (size_t j = 0; j < clip->tracks.size(); ++j)
+            {
+                animation::TransformTrack& track = clip->tracks[j];
+                track.boneID = tracks[j].boneID;
+                ReadCurve(reader, track.position, tracks[j].position);
+                ReadCurve(reader, track.rotation, tracks[j].rotation);
+                ReadCurve(reader, track.scale, tracks[j].scale);
+            }
+            loadedClips.push_back(clip);
+        }
+
+        // Meshes are expensive to copy, they are built in place and dropped again if the file turns
+        // out to be invalid
+        size_t firstMesh = meshes.size();
+        const MeshRecord* meshRecords = reader.Get<MeshRecord>(header->meshes);
+        size_t meshCount = meshRecords != nullptr ? header->meshes.count : 0;
+        meshes.reserve(firstMesh + meshCount);
+        for (size_t i = 0; i < meshCount; ++i)
+        {
+            const MeshRecord& record = meshRecords[i];
+            meshes.push_back(skin::AnimatedMesh());
+            skin::AnimatedMesh& mesh = meshes[meshes.size() - 1];
+            reader.Read(mesh.mPositions, record.positions);
+            reader.Read(mesh.mNormals, record.normals);
+            reader.Read(mesh.mTextureCoordinates, record.textureCoordinates);
+            reader.Read(mesh.mWeights, record.weights);
+            reader.Read(mesh.mInfluences, record.influences);
+            reader.Read(mesh.mIndices, record.indices);
+            ReadNested(reader, mesh.mLODWeights, record.lodWeights);
+            ReadNested(reader, mesh.mLODInfluences, record.lodInfluences);
+            mesh.mStorage = storage;
+        }
+
+        if (!reader.IsValid())
+        {
+            meshes.erase(meshes.begin() + firstMesh, meshes.end());
+            std::cout << "Corrupted cooked file: " << path << std::endl;
+            return false;
+        }
+
+        skeleton = std::move(loadedSkeleton);
+        clips.insert(clips.end(), loadedClips.begin(), loadedClips.end());
+        return true;
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include "Animation.h"
+#include "Skinning.h"
+
+// Cooked characters: a skeleton with its LODs, its clips and its meshes, stored the way they are laid
+// out in memory. Loading maps the file and points the clip tracks, frame tables and mesh attributes
+// straight at it instead of parsing JSON, decoding base64, converting accessors and rebuilding
+// lookup tables. Nothing in those arrays is fixed up or copied.
+//
+// The file is little-endian and position independent. Every array is 16-byte aligned and referenced
+// by a Range, an offset from the start of the file and an element count, never by a pointer.
+// Records only hold plain values and Ranges, so the header, the records and the arrays they point
+// to can all be read in place.
+namespace cooked
+{
+    constexpr uint32_t Magic = 0x4B4F4F43; // "COOK"
+    // Bump on every change to the records below or to the layout of the math types they store
+    constexpr uint32_t Version = 3;
+    constexpr uint64_t Alignment = 16;
+
+    struct Range
+    {
+        uint64_t offset = 0;
+        uint64_t count = 0;
+    };
+
+    struct LODRecord
+    {
+        Range joints;  // unsigned int
+        Range remap;   // unsigned int
+    };
+
+    struct SkeletonRecord
+    {
+        Range restPose;        // math::Transform
+        Range restParents;     // int
+        Range bindPose;        // math::Transform
+        Range bindParents;     // int
+        Range inverseBindPose; // math::mat4
+        Range jointNames;      // Range of char
+        Range lods;            // LODRecord
+    };
+
+    struct CurveRecord
+    {
+        Range frames;        // animation::Frame<T>
+        Range sampledFrames; // unsigned int
+        uint32_t interpolation = 0;
+        uint32_t padding = 0;
+    };
+
+    struct TrackRecord
+    {
+        uint32_t boneID = 0;
+        uint32_t padding = 0;
+        CurveRecord position;
+        CurveRecord rotation;
+        CurveRecord scale;
+    };
+
+    struct ClipRecord
+    {
+        Range name;         // char
+        Range tracks;       // TrackRecord
+        Range jointToTrack; // int
+        float startTime = 0.0f;
+        float endTime = 0.0f;
+    };
+
+    struct MeshRecord
+    {
+        Range positions;          // math::vec3
+        Range normals;            // math::vec3
+        Range textureCoordinates; // math::vec2
+        Range weights;            // math::vec4
+        Range influences;         // math::ivec4
+        Range indices;            // unsigned int
+        Range lodWeights;         // Range of math::vec4, one per skeleton LOD past the first
+        Range lodInfluences;      // Range of math::ivec4
+    };
+
+    struct Header
+    {
+        uint32_t magic = Magic;
+        uint32_t version = Version;
+        uint64_t size = 0; // of the whole file
+        uint64_t sourceHash = 0; // gltf::HashSource of what the file was cooked from, 0 when unknown
+        uint64_t optionsHash = 0; // of the options it was cooked with
+        SkeletonRecord skeleton;
+        Range clips;  // ClipRecord
+        Range meshes; // MeshRecord
+    };
+
+    enum class LOAD_MODE
+    {
+        // Clips and meshes view the mapped file, which stays mapped until the last of them is released.
+        // On Windows the file can not be cooked again meanwhile.
+        MAP,
+        // Everything is copied out of the file, which is closed before Load returns
+        COPY
+    };
+
+    // Writes a character, the skeleton's LODs and the meshes' LOD influences included.
+    // Returns false if the file could not be written.
+    bool Save(const char* path, const skin::Skeleton& skeleton, const std::vector<animation::ClipHandle>& clips,
+        const std::vector<skin::AnimatedMesh>& meshes, uint64_t sourceHash = 0, uint64_t optionsHash = 0);
+    // Returns the source hash of a file cooked with this version, 0 if it is missing or outdated.
+    // Compare it with gltf::HashSource of the source to tell whether the file is still current.
+    uint64_t GetSourceHash(const char* path, uint64_t* optionsHash = nullptr);
+    // Loads a character written by Save, clips are appended to clips and meshes to meshes. Returns
+    // false without touching the outputs if the file is missing, truncated or was cooked with another
+    // version. Meshes upload to the GPU on first use. The skeleton is always copied.
+    bool Load(const char* path, skin::Skeleton& skeleton, std::vector<animation::ClipHandle>& clips,
+        std::vector<skin::AnimatedMesh>& meshes, LOAD_MODE mode = LOAD_MODE::MAP);
+}
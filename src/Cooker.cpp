@@ -0,0 +1,404 @@
+// Offline cooker, turns .gltf and .glb files into cooked files the runtime loads without cgltf.
+//
+//   cooker [--force] [--out <directory>] [--lod <joint,joint,...>]... <file or directory>...
+//   cooker --benchmark <loads> <file or directory>...
+//
+// Directories are searched recursively. Each input is written next to itself as <name>.<ext>.cooked,
+// or with --out under its path relative to the parent of the directory it was found in, so
+// Woman.gltf and Woman.glb never share an output. Every --lod adds a skeleton LOD dropping the listed
+// joints on top of the previous one. Inputs whose source hash (the file, its external buffers and
+// the loader version) and options match the ones stored in the existing cooked file are skipped
+// unless --force is given.
+//
+// --benchmark cooks nothing, it loads every input <loads> times the way the app loads a glTF file and
+// prints the average time and heap allocations of a load and of each mesh attribute. Every global
+// operator new of the cooker is counted.
+#include "Cooked.h"
+#include "JobSystem.h"
+#include "gltf.h"
+#include "utils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    std::atomic<unsigned long long> gAllocationCount{ 0 };
+    std::atomic<unsigned long long> gAllocatedBytes{ 0 };
+    thread_local unsigned long long tAllocationCount = 0;
+    thread_local unsigned long long tAllocatedBytes = 0;
+
+    void CountAllocation(size_t size)
+    {
+        gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+        gAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        ++tAllocationCount;
+        tAllocatedBytes += size;
+    }
+
+    void CountThreadAllocations(unsigned long long& allocations, unsigned long long& bytes)
+    {
+        allocations = tAllocationCount;
+        bytes = tAllocatedBytes;
+    }
+
+    enum class COOK_RESULT
+    {
+        COOKED,
+        SKIPPED,
+        FAILED
+    };
+
+    struct Options
+    {
+        bool force = false;
+        unsigned int benchmarkLoads = 0;
+        fs::path outDirectory;
+        std::vector<std::vector<std::string>> lods;
+    };
+
+    struct Input
+    {
+        fs::path source;
+        fs::path relative; // output directory below the --out directory
+        fs::path cooked;
+        COOK_RESULT result = COOK_RESULT::FAILED;
+        double milliseconds = 0.0;
+    };
+
+    bool IsModel(const fs::path& path)
+    {
+        std::string extension = path.extension().string();
+        return extension == ".gltf" || extension == ".glb";
+    }
+
+    std::vector<std::string> Split(const std::string& text, char separator)
+    {
+        std::vector<std::string> result;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, separator))
+        {
+            if (!item.empty())
+            {
+                result.push_back(item);
+            }
+        }
+        return result;
+    }
+
+    Input MakeInput(const fs::path& source, const fs::path& relative)
+    {
+        Input input;
+        input.source = source;
+        input.relative = relative;
+        return input;
+    }
+
+    // Hashes everything in options that changes the output, and the cooked format version
+    uint64_t HashOptions(const Options& options)
+    {
+        uint64_t hash = utils::HashFNV1a(&cooked::Version, sizeof(cooked::Version));
+        for (const std::vector<std::string>& lod : options.lods)
+        {
+            for (const std::string& joint : lod)
+            {
+                hash = utils::HashFNV1a(joint.c_str(), joint.size() + 1, hash);
+            }
+            hash = utils::HashFNV1a("|", 1, hash);
+        }
+        return hash;
+    }
+
+    COOK_RESULT Cook(const Input& input, const Options& options, uint64_t optionsHash, jobs::JobSystem& jobSystem)
+    {
+        uint64_t sourceHash = gltf::HashSource(input.source.string().c_str());
+        if (sourceHash == 0)
+        {
+            std::cout << "Could not read " << input.source.string() << std::endl;
+            return COOK_RESULT::FAILED;
+        }
+
+        std::string cookedPath = input.cooked.string();
+        uint64_t cookedOptionsHash = 0;
+        if (!options.force && cooked::GetSourceHash(cookedPath.c_str(), &cookedOptionsHash) == sourceHash &&
+            cookedOptionsHash == optionsHash)
+        {
+            return COOK_RESULT::SKIPPED;
+        }
+
+        // Files are cooked in parallel, each one is loaded on the thread cooking it
+        cgltf_data* data = gltf::LoadGLTFFile(input.source.string().c_str());
+        if (data == nullptr)
+        {
+            return COOK_RESULT::FAILED;
+        }
+
+        // Spreads a large file over the threads that have run out of files to cook
+        skin::Skeleton skeleton;
+        std::vector<animation::ClipHandle> clips;
+        std::vector<skin::AnimatedMesh> meshes;
+        gltf::LoadScene(skeleton, clips, meshes, data, jobSystem);
+        gltf::FreeGLTFFile(data);
+
+        for (const std::vector<std::string>& lod : options.lods)
+        {
+            skeleton.AddLOD(lod);
+        }
+        if (!options.lods.empty())
+        {
+            for (skin::AnimatedMesh& mesh : meshes)
+            {
+                mesh.BuildLODs(skeleton);
+            }
+        }
+
+        return cooked::Save(cookedPath.c_str(), skeleton, clips, meshes, sourceHash, optionsHash) ? COOK_RESULT::COOKED : COOK_RESULT::FAILED;
+    }
+
+    // Loads source like AssetManager loads a glTF character, loadCount times
+    bool Benchmark(const fs::path& source, unsigned int loadCount, jobs::JobSystem& jobSystem)
+    {
+        std::string path = source.string();
+        gltf::MeshLoadStats stats;
+        stats.countAllocations = CountThreadAllocations;
+        double milliseconds = 0.0;
+        unsigned long long allocations = 0;
+        unsigned long long allocatedBytes = 0;
+        for (unsigned int i = 0; i < loadCount; ++i)
+        {
+            unsigned long long allocationsBefore = gAllocationCount.load();
+            unsigned long long bytesBefore = gAllocatedBytes.load();
+            auto start = std::chrono::steady_clock::now();
+            {
+                skin::Skeleton skeleton;
+                std::vector<animation::ClipHandle> clips;
+                std::vector<skin::AnimatedMesh> meshes;
+                cgltf_data* data = gltf::LoadGLTFFile(path.c_str(), &jobSystem);
+                if (data == nullptr)
+                {
+                    return false;
+                }
+                gltf::LoadScene(skeleton, clips, meshes, data, jobSystem, path.c_str(), &stats);
+                gltf::FreeGLTFFile(data);
+            }
+            milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            allocations += gAllocationCount.load() - allocationsBefore;
+            allocatedBytes += gAllocatedBytes.load() - bytesBefore;
+        }
+
+        std::cout << path << ": " << milliseconds / loadCount << " ms, " << allocations / loadCount << " allocations, "
+            << allocatedBytes / loadCount << " bytes allocated per load" << std::endl;
+        stats.Print(loadCount);
+        return true;
+    }
+
+    void PrintUsage()
+    {
+        std::cout << "usage: cooker [--force] [--out <directory>] [--lod <joint,joint,...>]... <file or directory>..." << std::endl;
+        std::cout << "       cooker --benchmark <loads> <file or directory>..." << std::endl;
+    }
+}
+
+void* operator new(size_t size)
+{
+    CountAllocation(size);
+    void* result = malloc(size > 0 ? size : 1);
+    if (result == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    CountAllocation(size);
+    const size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+    void* result = _aligned_malloc(size > 0 ? size : 1, align);
+#else
+    void* result = aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+    if (result == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+void operator delete(void* memory, size_t, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::vector<fs::path> sources;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        if (argument == "--force")
+        {
+            options.force = true;
+        }
+        else if (argument == "--out" && i + 1 < argc)
+        {
+            options.outDirectory = argv[++i];
+        }
+        else if (argument == "--lod" && i + 1 < argc)
+        {
+            options.lods.push_back(Split(argv[++i], ','));
+        }
+        else if (argument == "--benchmark" && i + 1 < argc)
+        {
+            options.benchmarkLoads = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+            if (options.benchmarkLoads == 0)
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (argument.compare(0, 2, "--") == 0)
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            sources.push_back(argument);
+        }
+    }
+
+    if (sources.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<Input> inputs;
+    std::error_code error;
+    for (const fs::path& source : sources)
+    {
+        if (fs::is_directory(source, error))
+        {
+            // Under --out, files keep their path below the directory, starting with its own name
+            fs::path name = fs::weakly_canonical(source, error).filename();
+            for (const fs::directory_entry& entry : fs::recursive_directory_iterator(source, error))
+            {
+                if (entry.is_regular_file() && IsModel(entry.path()))
+                {
+                    inputs.push_back(MakeInput(entry.path(), name / entry.path().parent_path().lexically_relative(source)));
+                }
+            }
+        }
+        else if (IsModel(source))
+        {
+            inputs.push_back(MakeInput(source, fs::path()));
+        }
+        else
+        {
+            std::cout << "Skipping " << source.string() << ", not a .gltf or .glb file" << std::endl;
+        }
+    }
+
+    // Outputs keep the source extension and directory. Two inputs can still collide when the same
+    // relative path is found under two directories given with --out, a file listed twice is cooked once.
+    std::map<fs::path, fs::path> outputs;
+    std::vector<Input> uniqueInputs;
+    for (Input& input : inputs)
+    {
+        fs::path directory = options.outDirectory.empty() ? input.source.parent_path() : options.outDirectory / input.relative;
+        input.cooked = (directory / input.source.filename()).lexically_normal();
+        input.cooked += ".cooked";
+
+        auto inserted = outputs.emplace(input.cooked, input.source);
+        if (!inserted.second)
+        {
+            if (fs::equivalent(inserted.first->second, input.source, error))
+            {
+                continue;
+            }
+            std::cout << "Both " << inserted.first->second.string() << " and " << input.source.string() << " would be cooked to "
+                << input.cooked.string() << std::endl;
+            return 1;
+        }
+        fs::create_directories(directory, error);
+        uniqueInputs.push_back(input);
+    }
+    inputs.swap(uniqueInputs);
+
+    uint64_t optionsHash = HashOptions(options);
+    jobs::JobSystem jobSystem;
+    jobSystem.Initialize();
+    if (options.benchmarkLoads > 0)
+    {
+        // One file at a time, each load spreads over every worker like in the app
+        bool loaded = true;
+        for (const Input& input : inputs)
+        {
+            if (!Benchmark(input.source, options.benchmarkLoads, jobSystem))
+            {
+                std::cout << "Could not load " << input.source.string() << std::endl;
+                loaded = false;
+            }
+        }
+        jobSystem.Shutdown();
+        return loaded ? 0 : 1;
+    }
+
+    auto cookInputs = [&](unsigned int begin, unsigned int end)
+    {
+        for (unsigned int i = begin; i < end; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+            inputs[i].result = Cook(inputs[i], options, optionsHash, jobSystem);
+            inputs[i].milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+    jobSystem.ParallelFor(static_cast<unsigned int>(inputs.size()), 1, cookInputs);
+    jobSystem.Shutdown();
+
+    unsigned int counts[3] = {};
+    const char* names[] = { "cooked ", "skipped", "FAILED " };
+    for (const Input& input : inputs)
+    {
+        ++counts[static_cast<int>(input.result)];
+        std::cout << names[static_cast<int>(input.result)] << " " << input.source.string() << " -> " << input.cooked.string()
+            << " (" << input.milliseconds << " ms)" << std::endl;
+    }
+    std::cout << counts[0] << " cooked, " << counts[1] << " skipped, " << counts[2] << " failed" << std::endl;
+    return counts[2] > 0 ? 1 : 0;
+}
@@ -0,0 +1,168 @@
+// Crowd benchmark, times AnimationWorld::Update over a synthetic crowd at 1, 2, 4 ... threads, up to
+// every hardware thread by default, and prints the speedup over a single thread.
+//
+//   crowd_benchmark [instances] [frames] [max threads]
+//
+// Every instance is in view and updated at the full rate, without a camera the world does not cull or
+// drop levels, so every thread count does the same work. Instances switch between two states at
+// staggered times so blends run all the time. Instances are GPU skinned, CPU skinning uploads to GL
+// buffers which needs a context.
+#include "AnimationWorld.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+    constexpr unsigned int JointCount = 64;
+    constexpr unsigned int KeyCount = 31;
+    constexpr unsigned int WarmupFrames = 60;
+    constexpr unsigned int TogglePeriod = 90;
+
+    // Every joint has a rotation and a position track, like a mocap clip
+    animation::Clip MakeClip(const char* name, float duration, float swing)
+    {
+        animation::Clip clip;
+        clip.name = name;
+        for (unsigned int joint = 0; joint < JointCount; ++joint)
+        {
+            animation::TransformTrack track;
+            track.boneID = joint;
+            animation::QuaternionFrame* rotations = track.rotation.frames.Resize(KeyCount);
+            animation::VectorFrame* positions = track.position.frames.Resize(KeyCount);
+            for (unsigned int i = 0; i < KeyCount; ++i)
+            {
+                const float time = duration * i / (KeyCount - 1);
+                const float angle = sinf(6.2831853f * i / (KeyCount - 1) + joint * 0.3f) * swing;
+                rotations[i].time = time;
+                rotations[i].value = math::normalized(math::Quaternion(angle, 0.5f * angle, 0.0f, 1.0f));
+                positions[i].time = time;
+                positions[i].value = math::vec3(0.0f, joint > 0 ? 0.1f : angle, 0.0f);
+            }
+            track.rotation.UpdateIndexLookupTable();
+            track.position.UpdateIndexLookupTable();
+            clip.tracks.push_back(track);
+        }
+        clip.RecalculateDuration();
+        return clip;
+    }
+
+    // Milliseconds per frame of instanceCount instances updated by threadCount threads
+    double Run(unsigned int threadCount, unsigned int instanceCount, unsigned int frameCount, unsigned int speed,
+        const skin::Skeleton& skeleton, const animation::StateMachine& stateMachine)
+    {
+        jobs::JobSystem jobSystem;
+        jobSystem.Initialize(threadCount);
+        std::vector<skin::AnimatedMesh> meshes;
+
+        double milliseconds = 0.0;
+        {
+            animation::AnimationWorld world;
+            world.Initialize(skeleton, stateMachine, meshes, &jobSystem);
+            world.Reserve(instanceCount);
+            for (unsigned int i = 0; i < instanceCount; ++i)
+            {
+                math::Transform model;
+                model.position = math::vec3(static_cast<float>(i % 100), 0.0f, static_cast<float>(i / 100));
+                animation::StateMachineInstance state = stateMachine.CreateInstance();
+                state.currentTime = (i % 37) * 0.027f;
+                world.Add(model, state, false);
+            }
+
+            std::chrono::steady_clock::time_point start;
+            for (unsigned int frame = 0; frame < WarmupFrames + frameCount; ++frame)
+            {
+                if (frame == WarmupFrames)
+                {
+                    start = std::chrono::steady_clock::now();
+                }
+
+                // A slice of the crowd changes its mind every frame
+                for (unsigned int i = frame % TogglePeriod; i < world.Size(); i += TogglePeriod)
+                {
+                    float value = (frame / TogglePeriod + i) % 2 == 0 ? 1.0f : 0.0f;
+                    stateMachine.SetParameter(world.GetState(i), speed, value);
+                }
+                world.Update(1.0f / 60.0f);
+            }
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            milliseconds = elapsed.count() / frameCount;
+            world.Clear();
+        }
+
+        jobSystem.Shutdown();
+        return milliseconds;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int instanceCount = argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 10000;
+    unsigned int frameCount = argc > 2 ? static_cast<unsigned int>(std::stoul(argv[2])) : 300;
+    unsigned int maxThreads = argc > 3 ? static_cast<unsigned int>(std::stoul(argv[3])) :
+        std::max(std::thread::hardware_concurrency(), 1u);
+    if (instanceCount == 0 || frameCount == 0 || maxThreads == 0)
+    {
+        std::cout << "usage: crowd_benchmark [instances] [frames] [max threads]" << std::endl;
+        return 1;
+    }
+
+    std::vector<animation::ClipHandle> clips;
+    clips.push_back(std::make_shared<const animation::Clip>(MakeClip("Walking", 1.0f, 0.4f)));
+    clips.push_back(std::make_shared<const animation::Clip>(MakeClip("Running", 0.7f, 0.8f)));
+
+    animation::StateMachineDefinition definition;
+    unsigned int speed = definition.AddParameter("speed");
+    unsigned int walking = definition.AddState("Walking", 0);
+    unsigned int running = definition.AddState("Running", 1);
+    unsigned int toRunning = definition.AddTransition(walking, running, 0.3f);
+    definition.AddCondition(toRunning, speed, animation::CONDITION::GREATER, 0.5f);
+    unsigned int toWalking = definition.AddTransition(running, walking, 0.3f);
+    definition.AddCondition(toWalking, speed, animation::CONDITION::LESS, 0.5f);
+
+    animation::StateMachine stateMachine;
+    if (!stateMachine.Compile(definition, clips))
+    {
+        return 1;
+    }
+
+    skin::Skeleton skeleton;
+    skeleton.restPose.Resize(JointCount);
+    for (unsigned int joint = 0; joint < JointCount; ++joint)
+    {
+        // A spine of eight joints, every other joint hangs off one of them like a shallow humanoid
+        skeleton.restPose.parents[joint] = joint < 8 ? static_cast<int>(joint) - 1 : static_cast<int>(joint % 8);
+        skeleton.restPose.joints[joint].position = math::vec3(0.0f, joint > 0 ? 0.1f : 0.0f, 0.0f);
+    }
+    skeleton.bindPose = skeleton.restPose;
+    skeleton.UpdateInverseBindPose();
+
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::cout << instanceCount << " instances, " << JointCount << " joints, " << frameCount << " frames" << std::endl;
+    std::cout << "threads   ms/frame   speedup   efficiency" << std::endl;
+    double single = 0.0;
+    for (unsigned int threads : threadCounts)
+    {
+        double milliseconds = Run(threads, instanceCount, frameCount, speed, skeleton, stateMachine);
+        if (threads == 1)
+        {
+            single = milliseconds;
+        }
+        double speedup = single / milliseconds;
+        char line[128];
+        snprintf(line, sizeof(line), "%7u %10.3f %9.2f %11.0f%%", threads, milliseconds, speedup, 100.0 * speedup / threads);
+        std::cout << line << std::endl;
+    }
+    return 0;
+}
@@ -7,25 +7,30 @@ using namespace math;
 
 DebugPose::DebugPose()
 {    
-    mVB = new gfx::VertexBuffer<math::vec3>(mPoints);
+    mVB = new gfx::VertexBuffer<math::vec3>(std::vector<math::vec3>());
 }
 
-void DebugPose::Update(const animation::Pose& pose)
+void DebugPose::Update(const animation::PoseView& pose)
 {
-    mPose = pose;
-    mPoints.clear();
-    unsigned int jointCount = (unsigned int)pose.joints.size();
+    mArena.Reset();
+
+    unsigned int jointCount = pose.Size();
+    math::Transform* globals = mArena.Allocate<math::Transform>(jointCount);
+    math::vec3* points = mArena.Allocate<math::vec3>(jointCount * 2);
+    pose.GetGlobalTransforms(globals);
+
+    mPointCount = 0;
     for (unsigned int i = 0; i < jointCount; ++i)
     {
         if (pose.parents[i] > 0)
         {
-            mPoints.push_back(pose.GlobalTransform(i).position);
-            mPoints.push_back(pose.GlobalTransform(pose.parents[i]).position);
+            points[mPointCount++] = globals[i].position;
+            points[mPointCount++] = globals[pose.parents[i]].position;
         }
     }
-    if (!mPoints.empty())
+    if (mPointCount > 0)
     {
-        mVB->Upload(mPoints);
+        mVB->Upload(points, mPointCount);
     }
 }
 
@@ -36,7 +41,7 @@ void DebugPose::Draw(gfx::draw::DRAW_MODE drawMode, gfx::Shader* shader, const m
     gfx::uniform::Update(shader->GetUniform("color"), color);
     mVB->Bind(shader->GetAttribute("position"));
 
-    gfx::draw::Draw(static_cast<unsigned int>(mPoints.size()), drawMode);
+    gfx::draw::Draw(mPointCount, drawMode);
 
     mVB->UnBind(shader->GetAttribute("position"));
     shader->UnBind();
@@ -72,24 +77,26 @@ void DebugRenderer::Initialize()
 
     mShader = new gfx::Shader(vs, ps);
     
-    cgltf_data* data = gltf::LoadGLTFFile("D:/projects/animation_system/assets/Woman.gltf");
+    const char* modelPath = "D:/projects/animation_system/assets/Woman.gltf";
+    cgltf_data* data = gltf::LoadGLTFFile(modelPath);
     mSkeleton = gltf::LoadSkeleton(data);
-    gltf::LoadAnimationClips(mClips, data);
+    gltf::LoadAnimationClips(mClips, data, modelPath);
 
     mRestPose = new DebugPose();
     mCurrentPose = new DebugPose();
     mBindPose = new DebugPose();
 
-    mRestPose->Update(mSkeleton.restPose);
-    mCurrentPose->Update(mSkeleton.restPose);
-    mBindPose->Update(mSkeleton.bindPose);
+    mAnimatedPose = mPosePool.Acquire(mSkeleton.restPose);
+    mRestPose->Update(mSkeleton.restPose.View());
+    mCurrentPose->Update(mAnimatedPose);
+    mBindPose->Update(mSkeleton.bindPose.View());
 
-    mCurrentClip = 0;
+    mCurrentClip = mClips.empty() ? nullptr : mClips[0];
     for (unsigned int i = 0; i < mClips.size(); ++i)
     {
-        if (mClips[i].name == "Walking")
+        if (mClips[i]->name == "Walking")
         {
-            mCurrentClip = i;
+            mCurrentClip = mClips[i];
             break;
         }
     }
@@ -98,8 +105,11 @@ void DebugRenderer::Initialize()
 
 void DebugRenderer::Update(float inDeltaTime)
 {    
-    mPlayBackTime = mClips[mCurrentClip].Sample(mCurrentPose->mPose, mPlayBackTime + inDeltaTime);
-    mCurrentPose->Update(mCurrentPose->mPose);
+    if (mCurrentClip)
+    {
+        mCurrentClip->Sample(mAnimatedPose, mPlayback, inDeltaTime);
+    }
+    mCurrentPose->Update(mAnimatedPose);
 }
 
 void DebugRenderer::Render(float inAspectRatio)
@@ -119,5 +129,8 @@ void DebugRenderer::Shutdown()
     delete mRestPose;
     delete mCurrentPose;
     delete mBindPose;
+    mPosePool.Release(mAnimatedPose);
+    mAnimatedPose = animation::PoseView();
+    mCurrentClip = nullptr;
     mClips.clear();
 }
\ No newline at end of file
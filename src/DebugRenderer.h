@@ -3,16 +3,19 @@
 #include "Gfx.h"
 #include "Math.h"
 #include "Animation.h"
+#include "FrameArena.h"
+#include "PosePool.h"
 #include "Skinning.h"
 
 struct DebugPose
 {
     gfx::VertexBuffer<math::vec3>* mVB;
-    std::vector<math::vec3> mPoints;
-    animation::Pose mPose;
+    unsigned int mPointCount = 0;
+    // Line points and global transforms are rebuilt every update
+    memory::FrameArena mArena;
 
     DebugPose();
-    void Update(const animation::Pose& pose);
+    void Update(const animation::PoseView& pose);
     void Draw(gfx::draw::DRAW_MODE drawMode, gfx::Shader* shader, const math::vec3& color, const math::mat4& mvp);
     ~DebugPose();
 };
@@ -20,13 +23,15 @@ struct DebugPose
 class DebugRenderer : public Application
 {
     gfx::Shader* mShader;
-    unsigned int mCurrentClip;
-    std::vector<animation::Clip> mClips;
+    std::vector<animation::ClipHandle> mClips;
+    animation::ClipHandle mCurrentClip;
+    animation::PlaybackState mPlayback;
     DebugPose* mRestPose;
     DebugPose* mCurrentPose;
     DebugPose* mBindPose;
     skin::Skeleton mSkeleton;
-    float mPlayBackTime;
+    animation::PosePool mPosePool;
+    animation::PoseView mAnimatedPose;
 
 public:
     void Initialize() override;
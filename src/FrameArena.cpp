@@ -0,0 +1,107 @@
+#include "FrameArena.h"
+
+#include <cassert>
+#include <new>
+
+namespace memory
+{
+    namespace
+    {
+        inline unsigned char* AllocateBlock(size_t bytes)
+        {
+            return static_cast<unsigned char*>(::operator new(bytes, std::align_val_t(FrameArena::MaxAlignment)));
+        }
+
+        inline void FreeBlock(unsigned char* block)
+        {
+            ::operator delete(block, std::align_val_t(FrameArena::MaxAlignment));
+        }
+    }
+
+    FrameArena::FrameArena(size_t capacity)
+    {
+        Reserve(capacity);
+    }
+
+    FrameArena::~FrameArena()
+    {
+        Reset();
+        if (mBuffer != nullptr)
+        {
+            FreeBlock(mBuffer);
+        }
+    }
+
+    void FrameArena::Reserve(size_t capacity)
+    {
+        if (capacity <= mCapacity)
+        {
+            return;
+        }
+
+        // Anything handed out from the old buffer stays valid until Reset
+        if (mBuffer != nullptr)
+        {
+            mOverflow.push_back(mBuffer);
+            mOverflowBytes += mOffset;
+        }
+
+        mBuffer = AllocateBlock(capacity);
+        mCapacity = capacity;
+        mOffset = 0;
+    }
+
+    void* FrameArena::Allocate(size_t bytes, size_t alignment)
+    {
+        assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= MaxAlignment);
+
+        size_t offset = (mOffset + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= mCapacity)
+        {
+            mOffset = offset + bytes;
+            if (mOffset + mOverflowBytes > mPeak)
+            {
+                mPeak = mOffset + mOverflowBytes;
+            }
+            return mBuffer + offset;
+        }
+
+        // Out of space for this frame, Reset grows the main buffer to the peak
+        unsigned char* block = AllocateBlock(bytes > 0 ? bytes : 1);
+        mOverflow.push_back(block);
+        mOverflowBytes += bytes;
+        if (mOffset + mOverflowBytes > mPeak)
+        {
+            mPeak = mOffset + mOverflowBytes;
+        }
+        return block;
+    }
+
+    void FrameArena::Reset()
+    {
+        mOffset = 0;
+        if (mOverflow.empty())
+        {
+            return;
+        }
+
+        for (unsigned char* block : mOverflow)
+        {
+            FreeBlock(block);
+        }
+        mOverflow.clear();
+        mOverflowBytes = 0;
+
+        // Leave some headroom so a slowly growing workload does not reallocate every frame
+        size_t capacity = mPeak + mPeak / 4 + MaxAlignment;
+        if (capacity > mCapacity)
+        {
+            if (mBuffer != nullptr)
+            {
+                FreeBlock(mBuffer);
+            }
+            mBuffer = AllocateBlock(capacity);
+            mCapacity = capacity;
+        }
+    }
+}
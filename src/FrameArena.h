@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace memory
+{
+    // Bump allocator for data that only lives until the end of the frame.
+    // Allocate is a pointer increment and Reset releases everything at once. A frame that needs
+    // more than the capacity spills into extra heap blocks and the next Reset grows the arena to
+    // that peak, so a steady workload stops touching the heap after its first frames.
+    // Not thread safe, use one arena per thread.
+    class alignas(64) FrameArena
+    {
+    public:
+        constexpr static size_t MaxAlignment = 64;
+
+        FrameArena() = default;
+        explicit FrameArena(size_t capacity);
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+        ~FrameArena();
+
+        void Reserve(size_t capacity);
+
+        // alignment must be a power of two no larger than MaxAlignment
+        void* Allocate(size_t bytes, size_t alignment = 16);
+
+        // Memory is not constructed, only use for types that are fully written before being read
+        template <typename T>
+        inline T* Allocate(size_t count)
+        {
+            return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        // Everything allocated after Mark is released by Rewind, for scratch memory with a shorter lifetime
+        inline size_t Mark() const
+        {
+            return mOffset;
+        }
+
+        inline void Rewind(size_t mark)
+        {
+            if (mark <= mOffset)
+            {
+                mOffset = mark;
+            }
+        }
+
+        void Reset();
+
+        inline size_t Capacity() const
+        {
+            return mCapacity;
+        }
+
+        // Largest number of bytes in use at once since the arena was created
+        inline size_t Peak() const
+        {
+            return mPeak;
+        }
+
+    private:
+        unsigned char* mBuffer = nullptr;
+        size_t mCapacity = 0;
+        size_t mOffset = 0;
+        size_t mPeak = 0;
+
+        // Blocks allocated after running out of capacity, freed by Reset
+        std::vector<unsigned char*> mOverflow;
+        size_t mOverflowBytes = 0;
+    };
+}
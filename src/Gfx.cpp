@@ -49,6 +49,32 @@ namespace gfx
         glVertexAttribPointer(slot, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
     }
 
+    // Quantized vertex data, the vertex shader reads these as floats in [-1, 1] and [0, 1]
+    template<>
+    void VertexBuffer<math::svec4>::SetAttributePointer(unsigned int slot)
+    {
+        glVertexAttribPointer(slot, 4, GL_SHORT, GL_TRUE, 0, (void*)0);
+    }
+
+    template<>
+    void VertexBuffer<math::usvec2>::SetAttributePointer(unsigned int slot)
+    {
+        glVertexAttribPointer(slot, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0, (void*)0);
+    }
+
+    template<>
+    void VertexBuffer<math::ubvec4>::SetAttributePointer(unsigned int slot)
+    {
+        glVertexAttribPointer(slot, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (void*)0);
+    }
+
+    // Joint indices, read as integers
+    template<>
+    void VertexBuffer<math::usvec4>::SetAttributePointer(unsigned int slot)
+    {
+        glVertexAttribIPointer(slot, 4, GL_UNSIGNED_SHORT, 0, (void*)0);
+    }
+
     // Uniform
 #define UNIFORM_IMPL(glFunction, templateType, dataType)                                                    \
     template<> void uniform::Update<templateType>(unsigned int slot, templateType* data, unsigned int len)  \
@@ -132,16 +158,27 @@ namespace gfx
 
     Texture::Texture(const char* filePath)
     {
-        glGenTextures(1, &handle);
-        glBindTexture(GL_TEXTURE_2D, handle);
         int w, h, c;
         unsigned char* data = stbi_load(filePath, &w, &h, &c, 4);
         width = w;
         height = h;
         channels = c;
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        Upload(data);
         stbi_image_free(data);
+    }
+
+    Texture::Texture(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int channels)
+        : width(width), height(height), channels(channels)
+    {
+        Upload(pixels);
+    }
+
+    void Texture::Upload(const unsigned char* pixels)
+    {
+        glGenTextures(1, &handle);
+        glBindTexture(GL_TEXTURE_2D, handle);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
@@ -166,7 +166,7 @@ namespace gfx
             return location;
         }
 
-        unsigned int handle;
+        unsigned int handle = GL_ZERO;
         std::map<std::string, unsigned int> attributes;
         std::map<std::string, unsigned int> uniforms;
     };
@@ -194,9 +194,15 @@ namespace gfx
 
         void Upload(const std::vector<T>& data)
         {
-            m_data = data;
+            Upload(data.data(), static_cast<unsigned int>(data.size()));
+        }
+
+        // GL copies the data, nothing is kept on the CPU side
+        void Upload(const T* data, unsigned int count)
+        {
+            size = count;
             glBindBuffer(GL_ARRAY_BUFFER, handle);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(T) * m_data.size(), m_data.data(), GL_STREAM_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(T) * count, data, GL_STREAM_DRAW);
             glBindBuffer(GL_ARRAY_BUFFER, GL_ZERO);
         }
 
@@ -217,7 +223,7 @@ namespace gfx
             glBindBuffer(GL_ARRAY_BUFFER, GL_ZERO);
         }
 
-        std::vector<T> m_data;
+        unsigned int size = 0;
         unsigned int handle;
     };
 
@@ -233,9 +239,9 @@ namespace gfx
         }
 
         template<typename T>
-        void Update(unsigned int slot, std::vector<T>& data)
+        void Update(unsigned int slot, const std::vector<T>& data)
         {
-            Update(slot, data.data(), static_cast<unsigned int>(data.size()));
+            Update(slot, (T*)data.data(), static_cast<unsigned int>(data.size()));
         }
     };
 
@@ -252,7 +258,12 @@ namespace gfx
 
         void Update(const std::vector<unsigned int>& data)
         {
-            m_data = data;
+            Update(data.data(), static_cast<unsigned int>(data.size()));
+        }
+
+        void Update(const unsigned int* data, unsigned int count)
+        {
+            m_data.assign(data, data + count);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle);
             glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_data.size() * sizeof(unsigned int), m_data.data(), GL_STATIC_DRAW);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_ZERO);
@@ -287,6 +298,8 @@ namespace gfx
         Texture operator=(const Texture&) = delete;
         
         Texture(const char* filePath);
+        // Uploads already decoded RGBA8 pixels, channels is what the source image had
+        Texture(const unsigned char* pixels, unsigned int width, unsigned int height, unsigned int channels);
         ~Texture();
         void Bind(unsigned int uniformIndex, unsigned int textureSlot);
         void UnBind(unsigned int textureSlot);
@@ -295,5 +308,7 @@ namespace gfx
         unsigned int height;
         unsigned int channels;
         unsigned int handle;
+    private:
+        void Upload(const unsigned char* pixels);
     };
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "JobSystem.h"
+
+namespace jobs
+{
+    namespace
+    {
+        // Set for worker threads and for the thread that initialized the job system
+        thread_local const JobSystem* tJobSystem = nullptr;
+        thread_local unsigned int tThreadIndex = 0;
+
+        constexpr unsigned int SpinsBeforeSleep = 64;
+    }
+
+    bool WorkQueue::Push(const Job& job)
+    {
+        long long bottom = mBottom.load(std::memory_order_relaxed);
+        long long top = mTop.load(std::memory_order_acquire);
+        if (bottom - top >= (long long)Capacity)
+        {
+            return false;
+        }
+
+        mJobs[bottom & (Capacity - 1)] = job;
+        mBottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool WorkQueue::Pop(Job& job)
+    {
+        long long bottom = mBottom.load(std::memory_order_relaxed) - 1;
+        mBottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long top = mTop.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Empty
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        job = mJobs[bottom & (Capacity - 1)];
+        if (top == bottom)
+        {
+            // Last job, race against thieves for it
+            bool won = mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    bool WorkQueue::Steal(Job& job)
+    {
+        long long top = mTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long bottom = mBottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+        {
+            return false;
+        }
+
+        job = mJobs[top & (Capacity - 1)];
+        return mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    JobSystem::~JobSystem()
+    {
+        Shutdown();
+    }
+
+    void JobSystem::Initialize(unsigned int threadCount)
+    {
+        Shutdown();
+
+        if (threadCount == 0)
+        {
+            threadCount = std::thread::hardware_concurrency();
+        }
+
+        if (threadCount == 0)
+        {
+            threadCount = 1;
+        }
+
+        mQueues.resize(threadCount);
+        for (unsigned int i = 0; i < threadCount; ++i)
+        {
+            mQueues[i] = new WorkQueue();
+        }
+
+        tJobSystem = this;
+        tThreadIndex = 0;
+        mRunning = true;
+        for (unsigned int i = 1; i < threadCount; ++i)
+        {
+            mThreads.emplace_back(&JobSystem::WorkerLoop, this, i);
+        }
+    }
+
+    void JobSystem::Shutdown()
+    {
+        if (!mRunning)
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mRunning = false;
+        }
+        mSleepCondition.notify_all();
+
+        for (std::thread& thread : mThreads)
+        {
+            thread.join();
+        }
+        mThreads.clear();
+
+        for (WorkQueue* queue : mQueues)
+        {
+            delete queue;
+        }
+        mQueues.clear();
+
+        if (tJobSystem == this)
+        {
+            tJobSystem = nullptr;
+        }
+    }
+
+    unsigned int JobSystem::ThreadIndex() const
+    {
+        return tJobSystem == this ? tThreadIndex : 0;
+    }
+
+    void JobSystem::Submit(JobFunction function, void* data, unsigned int begin, unsigned int end, std::atomic<unsigned int>& counter)
+    {
+        // Threads that do not own a queue, or a full queue, run the job right away
+        if (tJobSystem != this || mQueues.empty())
+        {
+            function(data, begin, end);
+            return;
+        }
+
+        Job job;
+        job.function = function;
+        job.data = data;
+        job.begin = begin;
+        job.end = end;
+        job.counter = &counter;
+
+        counter.fetch_add(1, std::memory_order_relaxed);
+        if (!mQueues[tThreadIndex]->Push(job))
+        {
+            function(data, begin, end);
+            counter.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+
+        mPendingJobs.fetch_add(1);
+        WakeWorkers();
+    }
+
+    void JobSystem::Wait(std::atomic<unsigned int>& counter)
+    {
+        unsigned int threadIndex = ThreadIndex();
+        while (counter.load(std::memory_order_acquire) != 0)
+        {
+            if (tJobSystem != this || !RunOne(threadIndex))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool JobSystem::RunOne(unsigned int threadIndex)
+    {
+        Job job;
+        bool found = mQueues[threadIndex]->Pop(job);
+
+        unsigned int queueCount = static_cast<unsigned int>(mQueues.size());
+        for (unsigned int i = 1; i < queueCount && !found; ++i)
+        {
+            found = mQueues[(threadIndex + i) % queueCount]->Steal(job);
+        }
+
+        if (!found)
+        {
+            return false;
+        }
+
+        mPendingJobs.fetch_sub(1);
+        job.function(job.data, job.begin, job.end);
+        job.counter->fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void JobSystem::WorkerLoop(unsigned int threadIndex)
+    {
+        tJobSystem = this;
+        tThreadIndex = threadIndex;
+
+        unsigned int idleSpins = 0;
+        while (mRunning.load(std::memory_order_relaxed))
+        {
+            if (RunOne(threadIndex))
+            {
+                idleSpins = 0;
+                continue;
+            }
+
+            if (++idleSpins < SpinsBeforeSleep)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleepers.fetch_add(1);
+            mSleepCondition.wait(lock, [this]()
+            {
+                return mPendingJobs.load() > 0 || !mRunning.load(std::memory_order_relaxed);
+            });
+            mSleepers.fetch_sub(1);
+            idleSpins = 0;
+        }
+    }
+
+    void JobSystem::WakeWorkers()
+    {
+        if (mSleepers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mSleepCondition.notify_all();
+        }
+    }
+}
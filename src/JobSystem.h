@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jobs
+{
+    typedef void (*JobFunction)(void* data, unsigned int begin, unsigned int end);
+
+    struct Job
+    {
+        JobFunction function = nullptr;
+        void* data = nullptr;
+        unsigned int begin = 0;
+        unsigned int end = 0;
+        std::atomic<unsigned int>* counter = nullptr;
+    };
+
+    // Chase-Lev work-stealing deque with a fixed capacity.
+    // Only the owning thread pushes and pops at the bottom, any thread may steal from the top.
+    class WorkQueue
+    {
+    public:
+        constexpr static unsigned int Capacity = 4096;
+
+        bool Push(const Job& job);
+        bool Pop(Job& job);
+        bool Steal(Job& job);
+
+    private:
+        alignas(64) std::atomic<long long> mTop{ 0 };
+        alignas(64) std::atomic<long long> mBottom{ 0 };
+        Job mJobs[Capacity];
+    };
+
+    // Fixed pool of worker threads, each owning a WorkQueue.
+    // The thread calling Initialize becomes worker 0 and helps executing jobs while it waits.
+    class JobSystem
+    {
+    public:
+        JobSystem() = default;
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+        ~JobSystem();
+
+        // threadCount includes the calling thread, 0 uses every hardware thread
+        void Initialize(unsigned int threadCount = 0);
+        void Shutdown();
+
+        inline unsigned int ThreadCount() const
+        {
+            return static_cast<unsigned int>(mQueues.size());
+        }
+
+        // Index of the calling thread in [0, ThreadCount()), used to pick per-thread scratch memory
+        unsigned int ThreadIndex() const;
+
+        // Queues a job on the calling thread's queue, the counter is incremented now
+        // and decremented once the job has run
+        void Submit(JobFunction function, void* data, unsigned int begin, unsigned int end, std::atomic<unsigned int>& counter);
+
+        // Runs other jobs until the counter reaches zero
+        void Wait(std::atomic<unsigned int>& counter);
+
+        // Splits [0, count) in ranges of at most grainSize items and blocks until all of them ran.
+        // function is called as function(begin, end).
+        template <typename F>
+        void ParallelFor(unsigned int count, unsigned int grainSize, F& function)
+        {
+            std::atomic<unsigned int> counter{ 0 };
+            ParallelFor(count, grainSize, function, counter);
+            Wait(counter);
+        }
+
+        // Same as above without waiting, function must outlive the counter reaching zero
+        template <typename F>
+        void ParallelFor(unsigned int count, unsigned int grainSize, F& function, std::atomic<unsigned int>& counter)
+        {
+            JobFunction invoke = [](void* data, unsigned int begin, unsigned int end)
+            {
+                (*static_cast<F*>(data))(begin, end);
+            };
+
+            if (grainSize == 0)
+            {
+                grainSize = 1;
+            }
+
+            for (unsigned int begin = 0; begin < count; begin += grainSize)
+            {
+                unsigned int end = begin + grainSize < count ? begin + grainSize : count;
+                Submit(invoke, &function, begin, end, counter);
+            }
+        }
+
+    private:
+        bool RunOne(unsigned int threadIndex);
+        void WorkerLoop(unsigned int threadIndex);
+        void WakeWorkers();
+
+        std::vector<WorkQueue*> mQueues;
+        std::vector<std::thread> mThreads;
+        std::atomic<bool> mRunning{ false };
+
+        // Only used to park idle workers, queues never take this lock
+        std::mutex mSleepMutex;
+        std::condition_variable mSleepCondition;
+        std::atomic<unsigned int> mSleepers{ 0 };
+        std::atomic<unsigned int> mPendingJobs{ 0 };
+    };
+}
@@ -32,6 +32,7 @@ namespace math
 
     typedef Tvec2<float> vec2;
     typedef Tvec2<int> ivec2;
+    typedef Tvec2<unsigned short> usvec2;
 
     template <typename T>
     struct Tvec4 {
@@ -56,6 +57,9 @@ namespace math
 
     typedef Tvec4<float> vec4;
     typedef Tvec4<int> ivec4;
+    typedef Tvec4<short> svec4;
+    typedef Tvec4<unsigned short> usvec4;
+    typedef Tvec4<unsigned char> ubvec4;
     typedef Tvec4<unsigned int> uivec4;
 
     struct vec3 {
@@ -0,0 +1,78 @@
+#include "PosePool.h"
+
+namespace animation
+{
+    PosePool::~PosePool()
+    {
+        Clear();
+    }
+
+    PoseView PosePool::Acquire(const Pose& source)
+    {
+        unsigned int jointCount = source.Size();
+        Bucket& bucket = GetBucket(jointCount);
+        if (bucket.freePoses.empty())
+        {
+            math::Transform* slab = new math::Transform[jointCount * PosesPerSlab];
+            bucket.slabs.push_back(slab);
+            bucket.freePoses.reserve(bucket.slabs.size() * PosesPerSlab);
+            // Hand out the slab front to back
+            for (unsigned int i = PosesPerSlab; i > 0; --i)
+            {
+                bucket.freePoses.push_back(slab + (i - 1) * jointCount);
+            }
+        }
+
+        PoseView pose;
+        pose.joints = bucket.freePoses.back();
+        pose.parents = source.parents.data();
+        pose.size = jointCount;
+        bucket.freePoses.pop_back();
+        ++mAcquired;
+
+        if (jointCount > 0)
+        {
+            memcpy(pose.joints, source.joints.data(), sizeof(math::Transform) * jointCount);
+        }
+        return pose;
+    }
+
+    void PosePool::Release(const PoseView& pose)
+    {
+        if (pose.joints == nullptr)
+        {
+            return;
+        }
+
+        GetBucket(pose.size).freePoses.push_back(pose.joints);
+        --mAcquired;
+    }
+
+    void PosePool::Clear()
+    {
+        for (Bucket& bucket : mBuckets)
+        {
+            for (math::Transform* slab : bucket.slabs)
+            {
+                delete[] slab;
+            }
+        }
+        mBuckets.clear();
+        mAcquired = 0;
+    }
+
+    PosePool::Bucket& PosePool::GetBucket(unsigned int jointCount)
+    {
+        for (Bucket& bucket : mBuckets)
+        {
+            if (bucket.jointCount == jointCount)
+            {
+                return bucket;
+            }
+        }
+
+        mBuckets.emplace_back();
+        mBuckets.back().jointCount = jointCount;
+        return mBuckets.back();
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include "Animation.h"
+
+namespace animation
+{
+    // Storage for poses that outlive a frame, grouped by joint count.
+    // Poses are views into slabs of PosesPerSlab poses that never move, so a view stays valid until
+    // it is released, and copying one into another is a single memcpy. The parents are not copied,
+    // views share them with the pose they were acquired from (usually the skeleton's rest pose),
+    // which must outlive them.
+    class PosePool
+    {
+    public:
+        constexpr static unsigned int PosesPerSlab = 64;
+
+        PosePool() = default;
+        PosePool(const PosePool&) = delete;
+        PosePool& operator=(const PosePool&) = delete;
+        ~PosePool();
+
+        // Returns a pose holding a copy of source's local transforms
+        PoseView Acquire(const Pose& source);
+        void Release(const PoseView& pose);
+        // Frees every slab, views that were not released become invalid
+        void Clear();
+
+        // Number of poses currently handed out
+        inline unsigned int Size() const
+        {
+            return mAcquired;
+        }
+
+    private:
+        struct Bucket
+        {
+            unsigned int jointCount = 0;
+            std::vector<math::Transform*> slabs;
+            std::vector<math::Transform*> freePoses;
+        };
+
+        Bucket& GetBucket(unsigned int jointCount);
+
+        // Skeletons come in few sizes, a linear search is enough
+        std::vector<Bucket> mBuckets;
+        unsigned int mAcquired = 0;
+    };
+}
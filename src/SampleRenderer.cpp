@@ -1,6 +1,5 @@
 #include "SampleRenderer.h"
 #include "Camera.h"
-#include "gltf.h"
 
 using namespace gfx;
 using namespace math;
@@ -9,116 +8,210 @@ using namespace math;
 
 void SampleRenderer::Initialize()
 {
-    cgltf_data* gltf = gltf::LoadGLTFFile("D:/projects/animation_system/assets/Woman.gltf");
-    gltf::LoadMeshes(mCPUMeshes, gltf);
-    mSkeleton = gltf::LoadSkeleton(gltf);
-    gltf::LoadAnimationClips(mClips, gltf);
-    gltf::FreeGLTFFile(gltf);
+    mJobSystem.Initialize();
+    mAssets.Initialize();
 
-    mGPUMeshes = mCPUMeshes;
+    mStaticShader = mAssets.RequestShader("D:/projects/animation_system/src/Shaders/static.vert", "D:/projects/animation_system/src/Shaders/lit.frag");
+    mSkinnedShader = mAssets.RequestShader("D:/projects/animation_system/src/Shaders/preskinned.vert", "D:/projects/animation_system/src/Shaders/lit.frag");
+    mDiffuseTexture = mAssets.RequestTexture("D:/projects/animation_system/assets/Woman.png");
+
+    // Cooked by the cooker tool, which always stores the source hash, the glTF file is only parsed when it has not been run
+    const char* modelPath = "D:/projects/animation_system/assets/Woman.gltf";
+    auto addLODs = [](assets::Character& character)
+    {
+        // Unless they were cooked in with --lod: fingers and joint ends first, then hands, feet and head
+        if (character.skeleton.lods.size() <= 1)
+        {
+            character.skeleton.AddLOD(std::vector<std::string>{ "HeadTop_End", "LeftToe_End", "RightToe_End",
+                "LeftHandThumb1", "LeftHandIndex1", "RightHandThumb1", "RightHandIndex1" });
+            character.skeleton.AddLOD(std::vector<std::string>{ "Head", "LeftHand", "RightHand", "LeftToeBase", "RightToeBase" });
+            for (auto& mesh : character.meshes)
+            {
+                mesh.BuildLODs(character.skeleton);
+            }
+        }
+    };
+    // Loads Woman.gltf.cooked instead while the cooker's output is up to date
+    mCharacter = mAssets.RequestCharacter(modelPath, addLODs);
+    mAssets.WhenLoaded(mCharacter, [this](assets::Asset<assets::Character>& character) { OnCharacterLoaded(character); });
+}
+
+void SampleRenderer::OnCharacterLoaded(assets::Asset<assets::Character>& asset)
+{
+    if (!asset.IsReady())
+    {
+        return;
+    }
+    assets::Character& character = asset.Get();
+    const std::vector<animation::ClipHandle>& clips = character.clips;
+
+    mGPUMeshes = character.meshes;
     for (auto& mesh : mGPUMeshes)
     {
         mesh.UpdateGPUBuffers();
     }
 
-    mStaticShader = new Shader("D:/projects/animation_system/src/Shaders/static.vert", "D:/projects/animation_system/src/Shaders/lit.frag");
-    mSkinnedShader = new Shader("D:/projects/animation_system/src/Shaders/preskinned.vert", "D:/projects/animation_system/src/Shaders/lit.frag");
-    mDiffuseTexture = new Texture("D:/projects/animation_system/assets/Woman.png");
-
-    mGPUAnimInfo.animatedPose = mSkeleton.restPose;
-    mGPUAnimInfo.posePalette.resize(mGPUAnimInfo.animatedPose.Size());
-
-    mCPUAnimInfo.animatedPose = mSkeleton.restPose;
-    mCPUAnimInfo.posePalette.resize(mCPUAnimInfo.animatedPose.Size());
-
-    mGPUAnimInfo.model.position = vec3(-2, 0, 0);
-    mCPUAnimInfo.model.position = vec3(2, 0, 0);
-
-    for (unsigned int i = 0; i < mClips.size(); ++i)
+    unsigned int idleClip = 0;
+    unsigned int walkingClip = 0;
+    unsigned int runningClip = 0;
+    unsigned int leanClip = 0;
+    for (unsigned int i = 0; i < clips.size(); ++i)
     {
-        if (mClips[i].name == "Walking")
+        if (clips[i]->name == "Idle")
+        {
+            idleClip = i;
+        }
+        else if (clips[i]->name == "Walking")
+        {
+            walkingClip = i;
+        }
+        else if (clips[i]->name == "Running")
         {
-            mCPUAnimInfo.clip = i;
+            runningClip = i;
         }
-        else if (mClips[i].name == "Running")
+        else if (clips[i]->name == "Lean_Left")
         {
-            mGPUAnimInfo.clip = i;
+            leanClip = i;
         }
     }
+
+    // Speed from idle to running along x, leaning to the left along y
+    animation::BlendSpace2D movement;
+    movement.AddSample(idleClip, 0.0f, 0.0f);
+    movement.AddSample(walkingClip, 0.5f, 0.0f);
+    movement.AddSample(runningClip, 1.0f, 0.0f);
+    movement.AddSample(leanClip, 0.0f, 1.0f);
+
+    animation::StateMachineDefinition locomotion;
+    unsigned int speed = locomotion.AddParameter("speed");
+    unsigned int lean = locomotion.AddParameter("lean");
+    unsigned int moving = locomotion.AddBlendSpaceState("Locomotion", locomotion.AddBlendSpace(movement), speed, lean);
+    locomotion.defaultState = moving;
+    if (!mLocomotion.Compile(locomotion, clips))
+    {
+        return;
+    }
+
+    mWorld.Initialize(character.skeleton, mLocomotion, character.meshes, &mJobSystem);
+    mWorld.SetSkeletonLODLevels({ { 0.3f, 0 }, { 0.1f, 1 }, { 0.0f, 2 } });
+
+    Transform model;
+    model.position = vec3(2, 0, 0);
+    animation::StateMachineInstance walker = mLocomotion.CreateInstance();
+    mLocomotion.SetParameter(walker, speed, 0.5f);
+    mWorld.Add(model, walker, true);
+
+    model.position = vec3(-2, 0, 0);
+    animation::StateMachineInstance runner = mLocomotion.CreateInstance();
+    mLocomotion.SetParameter(runner, speed, 1.0f);
+    mWorld.Add(model, runner, false);
+    mWorldReady = true;
 }
 
 void SampleRenderer::Update(float inDeltaTime)
 {
-    mCPUAnimInfo.playback = mClips[mCPUAnimInfo.clip].Sample(mCPUAnimInfo.animatedPose, mCPUAnimInfo.playback + inDeltaTime);
-    mGPUAnimInfo.playback = mClips[mGPUAnimInfo.clip].Sample(mGPUAnimInfo.animatedPose, mGPUAnimInfo.playback + inDeltaTime);
-
-    mCPUAnimInfo.animatedPose.GetMatrixPalette(mCPUAnimInfo.posePalette);
-    for (unsigned int i = 0; i < mCPUAnimInfo.posePalette.size(); ++i)
+    // Uploads the assets the loader finished, the character's callback fills the world
+    mAssets.Update();
+    if (!mWorldReady)
     {
-        mCPUAnimInfo.posePalette[i] = mCPUAnimInfo.posePalette[i] * mSkeleton.inverseBindPose[i];
+        return;
     }
 
-    for (auto& mesh : mCPUMeshes)
+    if (!mPipelinedUpdate)
     {
-        mesh.CPUSkin(mCPUAnimInfo.posePalette);
+        mWorld.Update(inDeltaTime);
+        return;
     }
 
-    mGPUAnimInfo.animatedPose.GetMatrixPalette(mGPUAnimInfo.posePalette);
-    for (unsigned int i = 0; i < mGPUAnimInfo.posePalette.size(); ++i)
-    {
-        mGPUAnimInfo.posePalette[i] = mGPUAnimInfo.posePalette[i] * mSkeleton.inverseBindPose[i];
-    }
+    // Frame fence, then start the next frame and upload the finished one while it runs
+    mWorld.EndUpdate();
+    mWorld.BeginUpdate(inDeltaTime);
+    mWorld.Upload();
 }
 
 void SampleRenderer::Render(float inAspectRatio)
 {
+    if (!mWorldReady || !mStaticShader->IsReady() || !mSkinnedShader->IsReady() || !mDiffuseTexture->IsReady())
+    {
+        return;
+    }
+    gfx::Shader* staticShader = &mStaticShader->Get();
+    gfx::Shader* skinnedShader = &mSkinnedShader->Get();
+    gfx::Texture* diffuseTexture = &mDiffuseTexture->Get();
+    std::vector<skin::AnimatedMesh>& cpuMeshes = mCharacter->Get().meshes;
+
     mat4 projection = transposed(perspective(60.0f, inAspectRatio, 0.01f, 1000.0f));
     mat4 view = lookAt(vec3(0, 5, 7), vec3(0, 3, 0), vec3(0, 1, 0));
     mat4 model;
+    // Culls and picks the levels of the next update
+    mWorld.SetCamera(view, projection);
 
-    // CPU Skinned Mesh
-    model = MatrixFromTransform(mCPUAnimInfo.model);
-    mStaticShader->Bind();
-    uniform::Update<mat4>(mStaticShader->GetUniform("model"), model);
-    uniform::Update<mat4>(mStaticShader->GetUniform("view"), view);
-    uniform::Update<mat4>(mStaticShader->GetUniform("projection"), projection);
-    uniform::Update<vec3>(mStaticShader->GetUniform("light"), vec3(1, 1, 1));
-
-    mDiffuseTexture->Bind(mStaticShader->GetUniform("tex0"), 0);
-    for (unsigned int i = 0, size = (unsigned int)mCPUMeshes.size(); i < size; ++i) {
-        mCPUMeshes[i].Bind(mStaticShader->GetAttribute("position"), mStaticShader->GetAttribute("normal"), mStaticShader->GetAttribute("texCoord"), -1, -1);
-        mCPUMeshes[i].Draw();
-        mCPUMeshes[i].UnBind(mStaticShader->GetAttribute("position"), mStaticShader->GetAttribute("normal"), mStaticShader->GetAttribute("texCoord"), -1, -1);
-    }
-    mDiffuseTexture->UnBind(0);
-    mStaticShader->UnBind();
-
-    // GPU Skinned Mesh
-    model = MatrixFromTransform(mGPUAnimInfo.model);
-    mSkinnedShader->Bind();
-    uniform::Update<mat4>(mSkinnedShader->GetUniform("model"), model);
-    uniform::Update<mat4>(mSkinnedShader->GetUniform("view"), view);
-    uniform::Update<mat4>(mSkinnedShader->GetUniform("projection"), projection);
-    uniform::Update<vec3>(mSkinnedShader->GetUniform("light"), vec3(1, 1, 1));
-
-    uniform::Update<mat4>(mSkinnedShader->GetUniform("animated"), mGPUAnimInfo.posePalette);
-
-    mDiffuseTexture->Bind(mSkinnedShader->GetUniform("tex0"), 0);
-    for (unsigned int i = 0, size = (unsigned int)mGPUMeshes.size(); i < size; ++i) {
-        mGPUMeshes[i].Bind(mSkinnedShader->GetAttribute("position"), mSkinnedShader->GetAttribute("normal"), mSkinnedShader->GetAttribute("texCoord"), mSkinnedShader->GetAttribute("weights"), mSkinnedShader->GetAttribute("joints"));
-        mGPUMeshes[i].Draw();
-        mGPUMeshes[i].UnBind(mSkinnedShader->GetAttribute("position"), mSkinnedShader->GetAttribute("normal"), mSkinnedShader->GetAttribute("texCoord"), mSkinnedShader->GetAttribute("weights"), mSkinnedShader->GetAttribute("joints"));
+    for (unsigned int i = 0; i < mWorld.Size(); ++i)
+    {
+        model = MatrixFromTransform(mWorld.GetModel(i));
+        if (mWorld.IsCPUSkinned(i))
+        {
+            // CPU Skinned Mesh
+            staticShader->Bind();
+            uniform::Update<mat4>(staticShader->GetUniform("model"), model);
+            uniform::Update<mat4>(staticShader->GetUniform("view"), view);
+            uniform::Update<mat4>(staticShader->GetUniform("projection"), projection);
+            uniform::Update<vec3>(staticShader->GetUniform("light"), vec3(1, 1, 1));
+
+            diffuseTexture->Bind(staticShader->GetUniform("tex0"), 0);
+            int position = staticShader->GetAttribute("position");
+            int normal = staticShader->GetAttribute("normal");
+            for (unsigned int j = 0, size = (unsigned int)cpuMeshes.size(); j < size; ++j) {
+                // Skinned vertices were uploaded to the instance buffers by the world update
+                mWorld.GetPositionBuffer(i, j)->Bind(position);
+                mWorld.GetNormalBuffer(i, j)->Bind(normal);
+                cpuMeshes[j].Bind(-1, -1, staticShader->GetAttribute("texCoord"), -1, -1);
+                uniform::Update<vec2>(staticShader->GetUniform("texCoordOffset"), cpuMeshes[j].mTexCoordOffset);
+                uniform::Update<vec2>(staticShader->GetUniform("texCoordScale"), cpuMeshes[j].mTexCoordScale);
+                cpuMeshes[j].Draw();
+                cpuMeshes[j].UnBind(-1, -1, staticShader->GetAttribute("texCoord"), -1, -1);
+                mWorld.GetNormalBuffer(i, j)->UnBind(normal);
+                mWorld.GetPositionBuffer(i, j)->UnBind(position);
+            }
+            diffuseTexture->UnBind(0);
+            staticShader->UnBind();
+        }
+        else
+        {
+            // GPU Skinned Mesh
+            skinnedShader->Bind();
+            uniform::Update<mat4>(skinnedShader->GetUniform("model"), model);
+            uniform::Update<mat4>(skinnedShader->GetUniform("view"), view);
+            uniform::Update<mat4>(skinnedShader->GetUniform("projection"), projection);
+            uniform::Update<vec3>(skinnedShader->GetUniform("light"), vec3(1, 1, 1));
+
+            uniform::Update<mat4>(skinnedShader->GetUniform("animated"), (mat4*)mWorld.GetPalette(i), mWorld.JointCount());
+
+            diffuseTexture->Bind(skinnedShader->GetUniform("tex0"), 0);
+            for (unsigned int j = 0, size = (unsigned int)mGPUMeshes.size(); j < size; ++j) {
+                mGPUMeshes[j].Bind(skinnedShader->GetAttribute("position"), skinnedShader->GetAttribute("normal"), skinnedShader->GetAttribute("texCoord"), skinnedShader->GetAttribute("weights"), skinnedShader->GetAttribute("joints"));
+                uniform::Update<vec3>(skinnedShader->GetUniform("positionOffset"), mGPUMeshes[j].mPositionOffset);
+                uniform::Update<vec3>(skinnedShader->GetUniform("positionScale"), mGPUMeshes[j].mPositionScale);
+                uniform::Update<vec2>(skinnedShader->GetUniform("texCoordOffset"), mGPUMeshes[j].mTexCoordOffset);
+                uniform::Update<vec2>(skinnedShader->GetUniform("texCoordScale"), mGPUMeshes[j].mTexCoordScale);
+                mGPUMeshes[j].Draw();
+                mGPUMeshes[j].UnBind(skinnedShader->GetAttribute("position"), skinnedShader->GetAttribute("normal"), skinnedShader->GetAttribute("texCoord"), skinnedShader->GetAttribute("weights"), skinnedShader->GetAttribute("joints"));
+            }
+            diffuseTexture->UnBind(0);
+            skinnedShader->UnBind();
+        }
     }
-    mDiffuseTexture->UnBind(0);
-    mSkinnedShader->UnBind();
 }
 
 void SampleRenderer::Shutdown()
 {
-    delete mStaticShader;
-    delete mDiffuseTexture;
-    delete mSkinnedShader;
-    mClips.clear();
-    mCPUMeshes.clear();
+    mWorld.Clear();
+    mWorldReady = false;
+    mAssets.Shutdown();
+    mJobSystem.Shutdown();
     mGPUMeshes.clear();
+    mCharacter.reset();
+    mStaticShader.reset();
+    mSkinnedShader.reset();
+    mDiffuseTexture.reset();
 }
\ No newline at end of file
@@ -1,31 +1,33 @@
 #pragma once
 #include "Application.h"
+#include "AssetManager.h"
 #include "Gfx.h"
 #include "Math.h"
 #include "Skinning.h"
 #include "Animation.h"
-
-struct AnimationInstance
-{
-    animation::Pose animatedPose;
-    std::vector<math::mat4> posePalette;
-    unsigned int clip = 0;
-    float playback = 0;
-    math::Transform model;
-};
+#include "AnimationWorld.h"
+#include "JobSystem.h"
+#include "StateMachine.h"
 
 class SampleRenderer : public Application
 {
-    gfx::Texture* mDiffuseTexture;
-    gfx::Shader* mStaticShader;
-    gfx::Shader* mSkinnedShader;
-    std::vector<skin::AnimatedMesh> mCPUMeshes;
+    assets::AssetManager mAssets;
+    assets::TextureHandle mDiffuseTexture;
+    assets::ShaderHandle mStaticShader;
+    assets::ShaderHandle mSkinnedShader;
+    // Its meshes are CPU skinned, mGPUMeshes is a copy skinned by the vertex shader
+    assets::CharacterHandle mCharacter;
     std::vector<skin::AnimatedMesh> mGPUMeshes;
-    skin::Skeleton mSkeleton;
-    std::vector<animation::Clip> mClips;
+    animation::StateMachine mLocomotion;
+
+    jobs::JobSystem mJobSystem;
+    animation::AnimationWorld mWorld;
+    // Animates the next frame on the workers while the current one is rendered, one frame of latency
+    bool mPipelinedUpdate = true;
+    // Set by the character's callback once the world holds its instances
+    bool mWorldReady = false;
 
-    AnimationInstance mGPUAnimInfo;
-    AnimationInstance mCPUAnimInfo;
+    void OnCharacterLoaded(assets::Asset<assets::Character>& asset);
 public:
     void Initialize() override;
     void Update(float inDeltaTime) override;
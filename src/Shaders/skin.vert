@@ -7,6 +7,12 @@ uniform mat4 projection;
 uniform mat4 pose[120];
 uniform mat4 invBindPose[120];
 
+// Positions and texture coordinates arrive normalized, see skin::AnimatedMesh
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec2 texCoordOffset;
+uniform vec2 texCoordScale;
+
 in vec3 position;
 in vec3 normal;
 in vec2 texCoord;
@@ -19,15 +25,17 @@ out vec2 uv;
 
 void main() {
     
+    vec3 restPosition = positionOffset + positionScale * position;
+
     // Construct skin matrix from the 4 influencing joints
     mat4 skin = (pose[joints.x] * invBindPose[joints.x]) * weights.x;
     skin += (pose[joints.y] * invBindPose[joints.y]) * weights.y;
     skin += (pose[joints.z] * invBindPose[joints.z]) * weights.z;
     skin += (pose[joints.w] * invBindPose[joints.w]) * weights.w;
 
-    gl_Position = projection * view * model * skin * vec4(position, 1.0);
+    gl_Position = projection * view * model * skin * vec4(restPosition, 1.0);
 
-    fragPos = vec3(model * skin * vec4(position, 1.0));
+    fragPos = vec3(model * skin * vec4(restPosition, 1.0));
     norm = vec3(model * skin * vec4(normal, 0.0f));
-    uv = texCoord;
+    uv = texCoordOffset + texCoordScale * texCoord;
 }
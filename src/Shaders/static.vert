@@ -4,6 +4,10 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Texture coordinates arrive normalized, see skin::AnimatedMesh
+uniform vec2 texCoordOffset;
+uniform vec2 texCoordScale;
+
 in vec3 position;
 in vec3 normal;
 in vec2 texCoord;
@@ -17,5 +21,5 @@ void main() {
     
     fragPos = vec3(model * vec4(position, 1.0));
     norm = vec3(model * vec4(normal, 0.0f));
-    uv = texCoord;
+    uv = texCoordOffset + texCoordScale * texCoord;
 }
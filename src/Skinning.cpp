@@ -1,5 +1,6 @@
 #include "Skinning.h"
 
+#include <iostream>
 #include <string>
 #include <vector>
 
@@ -16,27 +17,126 @@ namespace skin
             Transform world = bindPose.GlobalTransform(i);
             inverseBindPose[i] = inverse(MatrixFromTransform(world));
         }
+
+        SkeletonLOD full;
+        full.joints.resize(jointCount);
+        full.remap.resize(jointCount);
+        for (unsigned int i = 0; i < jointCount; ++i)
+        {
+            full.joints[i] = i;
+            full.remap[i] = i;
+        }
+        full.mask = animation::JointMask(jointCount, true);
+        lods.clear();
+        lods.push_back(full);
+    }
+
+    unsigned int Skeleton::AddLOD(const std::vector<unsigned int>& droppedJoints)
+    {
+        if (lods.empty())
+        {
+            UpdateInverseBindPose();
+        }
+
+        unsigned int jointCount = restPose.Size();
+        SkeletonLOD lod;
+        lod.remap = lods.back().remap;
+        for (unsigned int joint : droppedJoints)
+        {
+            if (joint >= jointCount || restPose.parents[joint] < 0)
+            {
+                std::cout << "Skeleton LOD can not drop joint " << joint << "\n";
+                continue;
+            }
+
+            // Descendants follow whatever the dropped joint follows
+            unsigned int ancestor = lod.remap[restPose.parents[joint]];
+            for (unsigned int i = 0; i < jointCount; ++i)
+            {
+                for (int parent = i; parent >= 0; parent = restPose.parents[parent])
+                {
+                    if (parent == (int)joint)
+                    {
+                        lod.remap[i] = ancestor;
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (unsigned int i = 0; i < jointCount; ++i)
+        {
+            if (lod.remap[i] == i)
+            {
+                lod.joints.push_back(i);
+            }
+        }
+        lod.mask = animation::JointMask(jointCount, lod.joints);
+
+        lods.push_back(lod);
+        return static_cast<unsigned int>(lods.size() - 1);
+    }
+
+    unsigned int Skeleton::AddLOD(const std::vector<std::string>& droppedJoints)
+    {
+        std::vector<unsigned int> joints;
+        for (const std::string& name : droppedJoints)
+        {
+            int joint = GetJointIndex(name);
+            if (joint < 0)
+            {
+                std::cout << "Skeleton LOD joint " << name << " not found\n";
+                continue;
+            }
+            joints.push_back(joint);
+        }
+        return AddLOD(joints);
+    }
+
+    int Skeleton::GetJointIndex(const std::string& name) const
+    {
+        for (unsigned int i = 0; i < jointNames.size(); ++i)
+        {
+            if (jointNames[i] == name)
+            {
+                return i;
+            }
+        }
+        return -1;
     }
 
     // Animated mesh
+    namespace
+    {
+        inline short QuantizeSnorm16(float value)
+        {
+            value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+            return static_cast<short>(value * 32767.0f + (value >= 0.0f ? 0.5f : -0.5f));
+        }
+
+        inline unsigned short QuantizeUnorm16(float value)
+        {
+            value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+            return static_cast<unsigned short>(value * 65535.0f + 0.5f);
+        }
+
+        // Half of a zero extent would divide by zero, any scale works for a flat axis
+        inline float NonZero(float scale)
+        {
+            return scale > 0.0f ? scale : 1.0f;
+        }
+    }
+
     AnimatedMesh::AnimatedMesh()
+        :mPositionAttribs(nullptr), mNormalAttribs(nullptr), mTextureAttribs(nullptr),
+        mWeightAttribs(nullptr), mInfluenceAttribs(nullptr), mPositionScale(1, 1, 1), mTexCoordScale(1, 1),
+        mIndexBuffer(nullptr)
     {
-        mPositionAttribs = new VertexBuffer<vec3>({});
-        mNormalAttribs = new VertexBuffer<vec3>({});
-        mTextureAttribs = new VertexBuffer<vec2>({});
-        mWeightAttribs = new VertexBuffer<vec4>({});
-        mInfluenceAttribs = new VertexBuffer<ivec4>({});
-        mIndexBuffer = new IndexBuffer({});
     }
 
     AnimatedMesh::AnimatedMesh(const AnimatedMesh& other)
+        :AnimatedMesh()
     {
-        mPositionAttribs = new VertexBuffer<vec3>({});
-        mNormalAttribs = new VertexBuffer<vec3>({});
-        mTextureAttribs = new VertexBuffer<vec2>({});
-        mWeightAttribs = new VertexBuffer<vec4>({});
-        mInfluenceAttribs = new VertexBuffer<ivec4>({});
-        mIndexBuffer = new IndexBuffer({});
         *this = other;
     }
 
@@ -62,12 +162,24 @@ namespace skin
         mTextureCoordinates = other.mTextureCoordinates;
         mWeights = other.mWeights;
         mInfluences = other.mInfluences;
+        mLODWeights = other.mLODWeights;
+        mLODInfluences = other.mLODInfluences;
         mIndices = other.mIndices;
-        UpdateGPUBuffers();
+        mStorage = other.mStorage;
+        mPositionOffset = other.mPositionOffset;
+        mPositionScale = other.mPositionScale;
+        mTexCoordOffset = other.mTexCoordOffset;
+        mTexCoordScale = other.mTexCoordScale;
+        // Meshes that never reached the GPU upload on first use
+        if (mIndexBuffer != nullptr)
+        {
+            UpdateGPUBuffers();
+        }
         return *this;
     }
 
-    void AnimatedMesh::CPUSkin(std::vector<math::mat4>& animatedPose)
+    void AnimatedMesh::CPUSkin(const math::mat4* animatedPose, std::vector<math::vec3>& outPositions,
+        std::vector<math::vec3>& outNormals, unsigned int lod) const
     {
         unsigned int vertexCount = static_cast<unsigned int>(mPositions.size());
         if (vertexCount == 0)
@@ -75,14 +187,35 @@ namespace skin
             return;
         }
 
-        mSkinnedPositions.resize(vertexCount, vec3());
-        mSkinnedNormals.resize(vertexCount, vec3());
+        outPositions.resize(vertexCount, vec3());
+        outNormals.resize(vertexCount, vec3());
+
+        if (lod > 0 && lod <= mLODWeights.size())
+        {
+            const vec4* weights = mLODWeights[lod - 1].data();
+            const ivec4* influences = mLODInfluences[lod - 1].data();
+            for (unsigned int i = 0; i < vertexCount; ++i)
+            {
+                const vec4& w = weights[i];
+                const ivec4& j = influences[i];
+
+                // Merged influences come first, the rest have a weight of 0
+                math::mat4 finalSkinMatrix = animatedPose[j.v[0]] * w.v[0];
+                for (unsigned int k = 1; k < 4 && w.v[k] > 0.0f; ++k)
+                {
+                    finalSkinMatrix = finalSkinMatrix + animatedPose[j.v[k]] * w.v[k];
+                }
+                outPositions[i] = TransformPoint(finalSkinMatrix, mPositions[i]);
+                outNormals[i] = TransformVector(finalSkinMatrix, mNormals[i]);
+            }
+            return;
+        }
 
         math::mat4 finalSkinMatrix;
         for (unsigned int i = 0; i < vertexCount; ++i)
         {
-            vec4& w = mWeights[i];
-            ivec4& j = mInfluences[i];
+            const vec4& w = mWeights[i];
+            const ivec4& j = mInfluences[i];
 
             math::mat4 skin[4];
             // Combine the inverse bind transform of the joint with the animated pose.
@@ -93,48 +226,191 @@ namespace skin
 
             // Blend between 4 influencing joints.
             finalSkinMatrix = skin[0] + skin[1] + skin[2] + skin[3];
-            mSkinnedPositions[i] = TransformPoint(finalSkinMatrix, mPositions[i]);
-            mSkinnedNormals[i] = TransformVector(finalSkinMatrix, mNormals[i]);
+            outPositions[i] = TransformPoint(finalSkinMatrix, mPositions[i]);
+            outNormals[i] = TransformVector(finalSkinMatrix, mNormals[i]);
+        }
+    }
+
+    void AnimatedMesh::BuildLODs(const Skeleton& skeleton)
+    {
+        unsigned int lodCount = skeleton.lods.size() > 1 ? static_cast<unsigned int>(skeleton.lods.size() - 1) : 0;
+        unsigned int vertexCount = static_cast<unsigned int>(mInfluences.size());
+        mLODWeights.resize(lodCount);
+        mLODInfluences.resize(lodCount);
+
+        for (unsigned int lod = 0; lod < lodCount; ++lod)
+        {
+            const std::vector<unsigned int>& remap = skeleton.lods[lod + 1].remap;
+            vec4* weights = mLODWeights[lod].Resize(vertexCount);
+            ivec4* influences = mLODInfluences[lod].Resize(vertexCount);
+            std::fill(weights, weights + vertexCount, vec4(0, 0, 0, 0));
+            std::fill(influences, influences + vertexCount, ivec4(0, 0, 0, 0));
+
+            for (unsigned int i = 0; i < vertexCount; ++i)
+            {
+                unsigned int used = 0;
+                for (unsigned int k = 0; k < 4; ++k)
+                {
+                    float weight = mWeights[i].v[k];
+                    int joint = mInfluences[i].v[k];
+                    if (weight <= 0.0f || joint < 0 || joint >= (int)remap.size())
+                    {
+                        continue;
+                    }
+                    joint = remap[joint];
+
+                    unsigned int slot = 0;
+                    while (slot < used && influences[i].v[slot] != joint)
+                    {
+                        ++slot;
+                    }
+                    if (slot == used)
+                    {
+                        influences[i].v[slot] = joint;
+                        ++used;
+                    }
+                    weights[i].v[slot] += weight;
+                }
+            }
         }
-        mPositionAttribs->Upload(mSkinnedPositions);
-        mNormalAttribs->Upload(mSkinnedNormals);
     }
 
     void AnimatedMesh::UpdateGPUBuffers()
     {
+        if (mIndexBuffer == nullptr)
+        {
+            mPositionAttribs = new VertexBuffer<svec4>({});
+            mNormalAttribs = new VertexBuffer<svec4>({});
+            mTextureAttribs = new VertexBuffer<usvec2>({});
+            mWeightAttribs = new VertexBuffer<ubvec4>({});
+            mInfluenceAttribs = new VertexBuffer<usvec4>({});
+            mIndexBuffer = new IndexBuffer({});
+        }
+
         if (!mPositions.empty())
         {
-            mPositionAttribs->Upload(mPositions);
+            vec3 minimum = mPositions[0];
+            vec3 maximum = mPositions[0];
+            for (const vec3& position : mPositions)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    minimum.v[c] = position.v[c] < minimum.v[c] ? position.v[c] : minimum.v[c];
+                    maximum.v[c] = position.v[c] > maximum.v[c] ? position.v[c] : maximum.v[c];
+                }
+            }
+            for (int c = 0; c < 3; ++c)
+            {
+                mPositionOffset.v[c] = (minimum.v[c] + maximum.v[c]) * 0.5f;
+                mPositionScale.v[c] = NonZero((maximum.v[c] - minimum.v[c]) * 0.5f);
+            }
+
+            std::vector<svec4> quantized(mPositions.size());
+            for (size_t i = 0; i < mPositions.size(); ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    quantized[i].v[c] = QuantizeSnorm16((mPositions[i].v[c] - mPositionOffset.v[c]) / mPositionScale.v[c]);
+                }
+            }
+            mPositionAttribs->Upload(quantized);
         }
 
         if (!mNormals.empty())
         {
-            mNormalAttribs->Upload(mNormals);
+            std::vector<svec4> quantized(mNormals.size());
+            for (size_t i = 0; i < mNormals.size(); ++i)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    quantized[i].v[c] = QuantizeSnorm16(mNormals[i].v[c]);
+                }
+            }
+            mNormalAttribs->Upload(quantized);
         }
 
         if (!mTextureCoordinates.empty())
         {
-            mTextureAttribs->Upload(mTextureCoordinates);
+            vec2 minimum = mTextureCoordinates[0];
+            vec2 maximum = mTextureCoordinates[0];
+            for (const vec2& uv : mTextureCoordinates)
+            {
+                for (int c = 0; c < 2; ++c)
+                {
+                    minimum.v[c] = uv.v[c] < minimum.v[c] ? uv.v[c] : minimum.v[c];
+                    maximum.v[c] = uv.v[c] > maximum.v[c] ? uv.v[c] : maximum.v[c];
+                }
+            }
+            mTexCoordOffset = minimum;
+            mTexCoordScale = vec2(NonZero(maximum.v[0] - minimum.v[0]), NonZero(maximum.v[1] - minimum.v[1]));
+
+            std::vector<usvec2> quantized(mTextureCoordinates.size());
+            for (size_t i = 0; i < mTextureCoordinates.size(); ++i)
+            {
+                for (int c = 0; c < 2; ++c)
+                {
+                    quantized[i].v[c] = QuantizeUnorm16((mTextureCoordinates[i].v[c] - mTexCoordOffset.v[c]) / mTexCoordScale.v[c]);
+                }
+            }
+            mTextureAttribs->Upload(quantized);
         }
 
         if (!mWeights.empty())
         {
-            mWeightAttribs->Upload(mWeights);
+            std::vector<ubvec4> quantized(mWeights.size());
+            for (size_t i = 0; i < mWeights.size(); ++i)
+            {
+                const vec4& weights = mWeights[i];
+                int values[4];
+                int sum = 0;
+                int largest = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    float weight = weights.v[c] < 0.0f ? 0.0f : (weights.v[c] > 1.0f ? 1.0f : weights.v[c]);
+                    values[c] = static_cast<int>(weight * 255.0f + 0.5f);
+                    sum += values[c];
+                    largest = weights.v[c] > weights.v[largest] ? c : largest;
+                }
+                // Rounding errors go to the largest weight so the skin matrix stays a blend
+                if (sum > 0)
+                {
+                    int value = values[largest] + 255 - sum;
+                    values[largest] = value < 0 ? 0 : (value > 255 ? 255 : value);
+                }
+                for (int c = 0; c < 4; ++c)
+                {
+                    quantized[i].v[c] = static_cast<unsigned char>(values[c]);
+                }
+            }
+            mWeightAttribs->Upload(quantized);
         }
 
         if (!mInfluences.empty())
         {
-            mInfluenceAttribs->Upload(mInfluences);
+            std::vector<usvec4> quantized(mInfluences.size());
+            for (size_t i = 0; i < mInfluences.size(); ++i)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    int joint = mInfluences[i].v[c];
+                    quantized[i].v[c] = static_cast<unsigned short>(joint < 0 ? 0 : (joint > 65535 ? 65535 : joint));
+                }
+            }
+            mInfluenceAttribs->Upload(quantized);
         }
 
         if (!mIndices.empty())
         {
-            mIndexBuffer->Update(mIndices);
+            mIndexBuffer->Update(mIndices.data(), static_cast<unsigned int>(mIndices.size()));
         }
     }
 
     void AnimatedMesh::Bind(int position, int normal, int texcoord, int weight, int influence)
     {
+        if (mIndexBuffer == nullptr)
+        {
+            UpdateGPUBuffers();
+        }
         if (position >= 0)
         {
             mPositionAttribs->Bind(position);
@@ -165,24 +441,28 @@ namespace skin
         }
         if (normal >= 0)
         {
-            mNormalAttribs->Bind(normal);
+            mNormalAttribs->UnBind(normal);
         }
         if (texcoord >= 0)
         {
-            mTextureAttribs->Bind(texcoord);
+            mTextureAttribs->UnBind(texcoord);
         }
         if (weight >= 0)
         {
-            mWeightAttribs->Bind(weight);
+            mWeightAttribs->UnBind(weight);
         }
         if (influence >= 0)
         {
-            mInfluenceAttribs->Bind(influence);
+            mInfluenceAttribs->UnBind(influence);
         }
     }
 
     void AnimatedMesh::Draw()
     {
+        if (mIndexBuffer == nullptr)
+        {
+            UpdateGPUBuffers();
+        }
         if (!mIndices.empty())
         {
             draw::Draw(*mIndexBuffer, draw::DRAW_MODE::TRIANGLES);
@@ -195,6 +475,10 @@ namespace skin
 
     void AnimatedMesh::DrawInstanced(unsigned int instanceCount)
     {
+        if (mIndexBuffer == nullptr)
+        {
+            UpdateGPUBuffers();
+        }
         if (!mIndices.empty())
         {
             draw::DrawInstanced(*mIndexBuffer, draw::DRAW_MODE::TRIANGLES, instanceCount);
@@ -4,6 +4,17 @@
 
 namespace skin
 {
+    // Joints animated at one level of detail. Lower levels drop whole subtrees (fingers, face,
+    // twist bones), so the parent of an active joint is always active.
+    struct SkeletonLOD
+    {
+        // Active joints in ascending order
+        std::vector<unsigned int> joints;
+        // Every joint of the skeleton -> itself when active, its closest active ancestor otherwise
+        std::vector<unsigned int> remap;
+        animation::JointMask mask;
+    };
+
     // Skeleton/Armature/Rig
     struct Skeleton
     {
@@ -11,43 +22,77 @@ namespace skin
         animation::Pose bindPose;
         std::vector<math::mat4> inverseBindPose;
         std::vector<std::string> jointNames;
+        // lods[0] holds every joint, the others are added from the most to the least detailed
+        std::vector<SkeletonLOD> lods;
 
-        // Must be called every time bind pose is updated
+        // Must be called every time bind pose is updated, removes every LOD but the first
         void UpdateInverseBindPose();
+        // Adds a LOD without droppedJoints and their descendants on top of what the previous LOD dropped.
+        // Returns the new LOD's index. Root joints can not be dropped.
+        unsigned int AddLOD(const std::vector<unsigned int>& droppedJoints);
+        unsigned int AddLOD(const std::vector<std::string>& droppedJoints);
+        // Returns -1 if no joint has that name
+        int GetJointIndex(const std::string& name) const;
     };
 
+    // The GL buffers are created by the first UpdateGPUBuffers, Bind or Draw, so meshes
+    // can be loaded and copied on threads without a GL context and only touch GL on the render thread.
+    //
+    // The GPU copies of the rest attributes are quantized, 32 bytes a vertex instead of 64. Positions
+    // and texture coordinates are 16 bit integers normalized within their bounds, which the vertex
+    // shader maps back with the offsets and scales below, normals are 16 bit and weights 8 bit
+    // normalized integers and joints 16 bit integers.
     struct AnimatedMesh
     {
-        std::vector<math::vec3> mPositions;
-        gfx::VertexBuffer<math::vec3>* mPositionAttribs;
+        // The attributes view mStorage when loaded from a cooked file, they own their elements otherwise
+        utils::Array<math::vec3> mPositions;
+        gfx::VertexBuffer<math::svec4>* mPositionAttribs;
+
+        utils::Array<math::vec3> mNormals;
+        gfx::VertexBuffer<math::svec4>* mNormalAttribs;
+
+        utils::Array<math::vec2> mTextureCoordinates;
+        gfx::VertexBuffer<math::usvec2>* mTextureAttribs;
 
-        std::vector<math::vec3> mNormals;
-        gfx::VertexBuffer<math::vec3>* mNormalAttribs;
+        utils::Array<math::vec4> mWeights;
+        gfx::VertexBuffer<math::ubvec4>* mWeightAttribs;
 
-        std::vector<math::vec2> mTextureCoordinates;
-        gfx::VertexBuffer<math::vec2>* mTextureAttribs;
+        utils::Array<math::ivec4> mInfluences;
+        gfx::VertexBuffer<math::usvec4>* mInfluenceAttribs;
 
-        std::vector<math::vec4> mWeights;
-        gfx::VertexBuffer<math::vec4>* mWeightAttribs;
+        // position = mPositionOffset + mPositionScale * quantized, set by UpdateGPUBuffers
+        math::vec3 mPositionOffset;
+        math::vec3 mPositionScale;
+        math::vec2 mTexCoordOffset;
+        math::vec2 mTexCoordScale;
 
-        std::vector<math::ivec4> mInfluences;
-        gfx::VertexBuffer<math::ivec4>* mInfluenceAttribs;
+        // Influences remapped to the active joints of skeleton LOD i + 1, joints merged into the same
+        // ancestor are summed up and the freed slots get a weight of 0. Built by BuildLODs.
+        std::vector<utils::Array<math::vec4>> mLODWeights;
+        std::vector<utils::Array<math::ivec4>> mLODInfluences;
 
-        std::vector<unsigned int> mIndices;
+        utils::Array<unsigned int> mIndices;
         gfx::IndexBuffer* mIndexBuffer;
 
-        // Internal caching for cpu skinning
-        // Optional
-        std::vector<math::vec3> mSkinnedPositions;
-        std::vector<math::vec3> mSkinnedNormals;
-        std::vector<math::mat4> mPosePalette;
+        std::shared_ptr<const utils::MappedFile> mStorage;
 
         AnimatedMesh();
         AnimatedMesh(const AnimatedMesh&);
         ~AnimatedMesh();
         AnimatedMesh& operator=(const AnimatedMesh&);
 
-        void CPUSkin(std::vector<math::mat4>& animatedPose);
+        // Skins into caller owned buffers without touching GL, safe to call from worker threads
+        inline void CPUSkin(const std::vector<math::mat4>& animatedPose, std::vector<math::vec3>& outPositions,
+            std::vector<math::vec3>& outNormals) const
+        {
+            CPUSkin(animatedPose.data(), outPositions, outNormals);
+        }
+        // Same as above with the palette read from contiguous memory. Below LOD 0 only the palette
+        // entries of the LOD's active joints are read.
+        void CPUSkin(const math::mat4* animatedPose, std::vector<math::vec3>& outPositions,
+            std::vector<math::vec3>& outNormals, unsigned int lod = 0) const;
+        // Must be called after the skeleton's LODs change
+        void BuildLODs(const Skeleton& skeleton);
         void UpdateGPUBuffers();
         void Bind(int position, int normals, int texcoord, int weight, int influence);
         void UnBind(int position, int normal, int texcoord, int weight, int influence);
@@ -0,0 +1,424 @@
+#include "StateMachine.h"
+
+#include <iostream>
+
+namespace animation
+{
+    unsigned int StateMachineDefinition::AddState(const std::string& name, unsigned int clip, bool looping, float speed)
+    {
+        State state;
+        state.name = name;
+        state.clip = clip;
+        state.looping = looping;
+        state.speed = speed;
+        states.push_back(state);
+        return static_cast<unsigned int>(states.size() - 1);
+    }
+
+    unsigned int StateMachineDefinition::AddBlendSpace(const BlendSpace2D& blendSpace)
+    {
+        blendSpaces.push_back(blendSpace);
+        return static_cast<unsigned int>(blendSpaces.size() - 1);
+    }
+
+    unsigned int StateMachineDefinition::AddBlendSpaceState(const std::string& name, unsigned int blendSpace,
+        unsigned int xParameter, unsigned int yParameter, float speed)
+    {
+        State state;
+        state.name = name;
+        state.blendSpace = blendSpace;
+        state.xParameter = xParameter;
+        state.yParameter = yParameter;
+        state.speed = speed;
+        states.push_back(state);
+        return static_cast<unsigned int>(states.size() - 1);
+    }
+
+    unsigned int StateMachineDefinition::AddParameter(const std::string& name)
+    {
+        parameters.push_back(name);
+        return static_cast<unsigned int>(parameters.size() - 1);
+    }
+
+    unsigned int StateMachineDefinition::AddTransition(unsigned int from, unsigned int to, float blendDuration)
+    {
+        Transition transition;
+        transition.from = from;
+        transition.to = to;
+        transition.blendDuration = blendDuration;
+        transitions.push_back(transition);
+        return static_cast<unsigned int>(transitions.size() - 1);
+    }
+
+    void StateMachineDefinition::AddCondition(unsigned int transition, unsigned int parameter, CONDITION kind, float value)
+    {
+        Condition condition;
+        condition.parameter = parameter;
+        condition.kind = kind;
+        condition.value = value;
+        transitions[transition].conditions.push_back(condition);
+    }
+
+    bool StateMachine::Compile(const StateMachineDefinition& definition, const std::vector<ClipHandle>& clips)
+    {
+        mClips = clips;
+        mBlendSpaces = definition.blendSpaces;
+        mStates.clear();
+        mInstructions.clear();
+        mStateNames.clear();
+        mParameterNames = definition.parameters;
+
+        if (definition.parameters.size() > MaxStateMachineParameters)
+        {
+            std::cout << "State machine has too many parameters\n";
+            return false;
+        }
+
+        unsigned int stateCount = static_cast<unsigned int>(definition.states.size());
+        if (definition.defaultState >= stateCount)
+        {
+            std::cout << "State machine has no valid default state\n";
+            return false;
+        }
+        mDefaultState = definition.defaultState;
+
+        for (BlendSpace2D& blendSpace : mBlendSpaces)
+        {
+            if (!blendSpace.Build(clips))
+            {
+                return false;
+            }
+        }
+
+        mStates.resize(stateCount);
+        mStateNames.resize(stateCount);
+        for (unsigned int i = 0; i < stateCount; ++i)
+        {
+            const StateMachineDefinition::State& source = definition.states[i];
+            State& state = mStates[i];
+            state.clip = source.clip;
+            state.speed = source.speed;
+            state.looping = source.looping;
+            state.blendSpace = source.blendSpace;
+            state.xParameter = static_cast<unsigned char>(source.xParameter);
+            state.yParameter = static_cast<unsigned char>(source.yParameter);
+            state.startTime = 0.0f;
+            state.duration = 0.0f;
+            if (source.blendSpace != NoBlendSpace)
+            {
+                if (source.blendSpace >= mBlendSpaces.size())
+                {
+                    std::cout << "State " << source.name << " refers to a missing blend space\n";
+                    return false;
+                }
+                if (source.xParameter >= definition.parameters.size() || source.yParameter >= definition.parameters.size())
+                {
+                    std::cout << "State " << source.name << " positions its blend space with a missing parameter\n";
+                    return false;
+                }
+                state.looping = true;
+            }
+            else if (source.clip >= clips.size() || !clips[source.clip])
+            {
+                std::cout << "State " << source.name << " refers to a missing clip\n";
+                return false;
+            }
+            else
+            {
+                state.startTime = clips[source.clip]->startTime;
+                state.duration = clips[source.clip]->GetDuration();
+            }
+            state.firstInstruction = static_cast<unsigned int>(mInstructions.size());
+            mStateNames[i] = source.name;
+
+            // Emit the transitions leaving this state, keeping their authoring order
+            for (const StateMachineDefinition::Transition& transition : definition.transitions)
+            {
+                if (transition.from != i)
+                {
+                    continue;
+                }
+
+                if (transition.to >= stateCount)
+                {
+                    std::cout << "Transition from " << source.name << " targets a missing state\n";
+                    return false;
+                }
+
+                unsigned int conditionCount = static_cast<unsigned int>(transition.conditions.size());
+                for (unsigned int j = 0; j < conditionCount; ++j)
+                {
+                    const StateMachineDefinition::Condition& condition = transition.conditions[j];
+                    if (condition.kind != CONDITION::STATE_FINISHED && condition.parameter >= definition.parameters.size())
+                    {
+                        std::cout << "Transition from " << source.name << " tests a missing parameter\n";
+                        return false;
+                    }
+
+                    Instruction instruction;
+                    switch (condition.kind)
+                    {
+                    case CONDITION::GREATER:
+                        instruction.op = OPCODE::TEST_GREATER;
+                        break;
+                    case CONDITION::LESS:
+                        instruction.op = OPCODE::TEST_LESS;
+                        break;
+                    case CONDITION::EQUAL:
+                        instruction.op = OPCODE::TEST_EQUAL;
+                        break;
+                    case CONDITION::NOT_EQUAL:
+                        instruction.op = OPCODE::TEST_NOT_EQUAL;
+                        break;
+                    case CONDITION::STATE_FINISHED:
+                        instruction.op = OPCODE::TEST_FINISHED;
+                        break;
+                    }
+                    instruction.parameter = static_cast<unsigned char>(condition.parameter);
+                    // Skip the remaining tests and the TRANSITION instruction
+                    instruction.jump = static_cast<unsigned short>(conditionCount - j + 1);
+                    instruction.target = InvalidState;
+                    instruction.value = condition.value;
+                    mInstructions.push_back(instruction);
+                }
+
+                Instruction instruction;
+                instruction.op = OPCODE::TRANSITION;
+                instruction.parameter = 0;
+                instruction.jump = 1;
+                instruction.target = transition.to;
+                instruction.value = transition.blendDuration;
+                mInstructions.push_back(instruction);
+            }
+
+            state.instructionCount = static_cast<unsigned int>(mInstructions.size()) - state.firstInstruction;
+        }
+
+        return true;
+    }
+
+    StateMachineInstance StateMachine::CreateInstance() const
+    {
+        return CreateInstance(mDefaultState);
+    }
+
+    StateMachineInstance StateMachine::CreateInstance(unsigned int state) const
+    {
+        StateMachineInstance instance;
+        instance.currentState = state < mStates.size() ? state : mDefaultState;
+        return instance;
+    }
+
+    int StateMachine::GetParameterIndex(const std::string& name) const
+    {
+        for (unsigned int i = 0; i < mParameterNames.size(); ++i)
+        {
+            if (mParameterNames[i] == name)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    unsigned int StateMachine::GetStateIndex(const std::string& name) const
+    {
+        for (unsigned int i = 0; i < mStateNames.size(); ++i)
+        {
+            if (mStateNames[i] == name)
+            {
+                return i;
+            }
+        }
+        return InvalidState;
+    }
+
+    void StateMachine::SetParameter(StateMachineInstance& instance, unsigned int parameter, float value) const
+    {
+        if (parameter < MaxStateMachineParameters)
+        {
+            instance.parameters[parameter] = value;
+        }
+    }
+
+    void StateMachine::Update(StateMachineInstance* instances, unsigned int count, float deltaTime) const
+    {
+        const State* states = mStates.data();
+        const Instruction* program = mInstructions.data();
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            StateMachineInstance& instance = instances[i];
+            const State& current = states[instance.currentState];
+
+            instance.currentTime += deltaTime * current.speed;
+            if (current.blendSpace != NoBlendSpace)
+            {
+                instance.currentPhase = AdvancePhase(current, instance, instance.currentPhase, deltaTime * current.speed);
+            }
+            if (instance.previousState != InvalidState)
+            {
+                const State& previous = states[instance.previousState];
+                instance.previousTime += deltaTime * previous.speed;
+                if (previous.blendSpace != NoBlendSpace)
+                {
+                    instance.previousPhase = AdvancePhase(previous, instance, instance.previousPhase, deltaTime * previous.speed);
+                }
+                instance.blendTime += deltaTime;
+                if (instance.blendTime >= instance.blendDuration)
+                {
+                    instance.previousState = InvalidState;
+                }
+                else
+                {
+                    // Let the running blend finish first, replacing its source would pop the pose
+                    continue;
+                }
+            }
+
+            const Instruction* pc = program + current.firstInstruction;
+            const Instruction* end = pc + current.instructionCount;
+            while (pc < end)
+            {
+                bool passed = true;
+                switch (pc->op)
+                {
+                case OPCODE::TEST_GREATER:
+                    passed = instance.parameters[pc->parameter] > pc->value;
+                    break;
+                case OPCODE::TEST_LESS:
+                    passed = instance.parameters[pc->parameter] < pc->value;
+                    break;
+                case OPCODE::TEST_EQUAL:
+                    passed = instance.parameters[pc->parameter] == pc->value;
+                    break;
+                case OPCODE::TEST_NOT_EQUAL:
+                    passed = instance.parameters[pc->parameter] != pc->value;
+                    break;
+                case OPCODE::TEST_FINISHED:
+                    passed = current.blendSpace == NoBlendSpace ? instance.currentTime >= current.duration :
+                        instance.currentPhase >= 1.0f;
+                    break;
+                case OPCODE::TRANSITION:
+                    instance.previousState = instance.currentState;
+                    instance.previousTime = instance.currentTime;
+                    instance.previousPhase = instance.currentPhase;
+                    instance.currentState = pc->target;
+                    instance.currentTime = 0.0f;
+                    instance.currentPhase = 0.0f;
+                    instance.blendTime = 0.0f;
+                    instance.blendDuration = pc->value;
+                    if (pc->value <= 0.0f)
+                    {
+                        instance.previousState = InvalidState;
+                    }
+                    // At most one transition per update
+                    pc = end;
+                    continue;
+                }
+
+                pc += passed ? 1 : pc->jump;
+            }
+        }
+    }
+
+    void StateMachine::Sample(const StateMachineInstance& instance, Pose& outPose, Pose& scratch) const
+    {
+        float t = SampleLayers(instance, outPose, scratch);
+        if (t < 1.0f)
+        {
+            Blend(outPose, scratch, outPose, t);
+        }
+    }
+
+    float StateMachine::SampleLayers(const StateMachineInstance& instance, const PoseView& outPose, const PoseView& previousPose) const
+    {
+        const State& current = mStates[instance.currentState];
+        SampleState(current, instance, instance.currentTime, instance.currentPhase, outPose);
+
+        if (instance.previousState == InvalidState || instance.blendDuration <= 0.0f)
+        {
+            return 1.0f;
+        }
+
+        const State& previous = mStates[instance.previousState];
+        previousPose.CopyFrom(outPose);
+        SampleState(previous, instance, instance.previousTime, instance.previousPhase, previousPose);
+
+        return instance.blendTime / instance.blendDuration;
+    }
+
+    float StateMachine::SampleLayers(const StateMachineInstance& instance, const PoseView& outPose, const PoseView& previousPose,
+        const JointMask& mask) const
+    {
+        const State& current = mStates[instance.currentState];
+        SampleState(current, instance, instance.currentTime, instance.currentPhase, outPose, mask);
+
+        if (instance.previousState == InvalidState || instance.blendDuration <= 0.0f)
+        {
+            return 1.0f;
+        }
+
+        const State& previous = mStates[instance.previousState];
+        previousPose.CopyFrom(outPose);
+        SampleState(previous, instance, instance.previousTime, instance.previousPhase, previousPose, mask);
+
+        return instance.blendTime / instance.blendDuration;
+    }
+
+    float StateMachine::AdvancePhase(const State& state, const StateMachineInstance& instance, float phase, float deltaTime) const
+    {
+        const BlendSpace2D& blendSpace = mBlendSpaces[state.blendSpace];
+        const float duration = blendSpace.GetDuration(blendSpace.Evaluate(instance.parameters[state.xParameter],
+            instance.parameters[state.yParameter]));
+        if (duration <= 0.0f)
+        {
+            return phase;
+        }
+
+        // Past the first cycle only the fraction matters, keep the phase small so it stays precise
+        phase += deltaTime / duration;
+        if (phase >= 2.0f)
+        {
+            phase = 1.0f + fmodf(phase - 1.0f, 1.0f);
+        }
+        return phase;
+    }
+
+    void StateMachine::SampleState(const State& state, const StateMachineInstance& instance, float time, float phase,
+        const PoseView& outPose) const
+    {
+        if (state.blendSpace == NoBlendSpace)
+        {
+            mClips[state.clip]->Sample(outPose, state.startTime + time, state.looping);
+            return;
+        }
+
+        const BlendSpace2D& blendSpace = mBlendSpaces[state.blendSpace];
+        blendSpace.Sample(blendSpace.Evaluate(instance.parameters[state.xParameter], instance.parameters[state.yParameter]),
+            phase - floorf(phase), outPose);
+    }
+
+    void StateMachine::SampleState(const State& state, const StateMachineInstance& instance, float time, float phase,
+        const PoseView& outPose, const JointMask& mask) const
+    {
+        if (state.blendSpace == NoBlendSpace)
+        {
+            mClips[state.clip]->Sample(outPose, state.startTime + time, state.looping, mask, state.clip);
+            return;
+        }
+
+        const BlendSpace2D& blendSpace = mBlendSpaces[state.blendSpace];
+        blendSpace.Sample(blendSpace.Evaluate(instance.parameters[state.xParameter], instance.parameters[state.yParameter]),
+            phase - floorf(phase), outPose, mask);
+    }
+
+    void StateMachine::BindMask(JointMask& mask) const
+    {
+        mask.ClearBindings();
+        for (const ClipHandle& clip : mClips)
+        {
+            mask.Bind(clip);
+        }
+    }
+}
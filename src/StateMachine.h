@@ -0,0 +1,199 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Animation.h"
+#include "BlendSpace.h"
+
+namespace animation
+{
+    constexpr static unsigned int MaxStateMachineParameters = 8;
+    constexpr static unsigned int InvalidState = (unsigned int)-1;
+    constexpr static unsigned int NoBlendSpace = (unsigned int)-1;
+
+    enum class CONDITION
+    {
+        GREATER,
+        LESS,
+        EQUAL,
+        NOT_EQUAL,
+        STATE_FINISHED // the current state played its clip to the end once
+    };
+
+    // Authoring-time description of a state machine.
+    // Only used to build a StateMachine, never touched while evaluating.
+    struct StateMachineDefinition
+    {
+        struct State
+        {
+            std::string name;
+            unsigned int clip = 0;
+            float speed = 1.0f;
+            bool looping = true;
+            // Plays this blend space instead of clip, positioned by two parameters
+            unsigned int blendSpace = NoBlendSpace;
+            unsigned int xParameter = 0;
+            unsigned int yParameter = 0;
+        };
+
+        struct Condition
+        {
+            unsigned int parameter = 0;
+            CONDITION kind = CONDITION::GREATER;
+            float value = 0.0f;
+        };
+
+        struct Transition
+        {
+            unsigned int from = 0;
+            unsigned int to = 0;
+            float blendDuration = 0.0f;
+            // All conditions must hold for the transition to fire
+            std::vector<Condition> conditions;
+        };
+
+        std::vector<State> states;
+        std::vector<Transition> transitions;
+        std::vector<std::string> parameters;
+        // Samples refer to the clips passed to Compile, which builds them
+        std::vector<BlendSpace2D> blendSpaces;
+        unsigned int defaultState = 0;
+
+        unsigned int AddState(const std::string& name, unsigned int clip, bool looping = true, float speed = 1.0f);
+        unsigned int AddBlendSpace(const BlendSpace2D& blendSpace);
+        // Blend space states always loop, they finish once their shared phase completed a cycle
+        unsigned int AddBlendSpaceState(const std::string& name, unsigned int blendSpace, unsigned int xParameter,
+            unsigned int yParameter, float speed = 1.0f);
+        unsigned int AddParameter(const std::string& name);
+        // Transitions leaving the same state are tested in the order they were added
+        unsigned int AddTransition(unsigned int from, unsigned int to, float blendDuration);
+        void AddCondition(unsigned int transition, unsigned int parameter, CONDITION kind, float value = 0.0f);
+    };
+
+    // Per-instance state block, plain data so thousands of them can live in one array.
+    struct StateMachineInstance
+    {
+        unsigned int currentState = 0;
+        unsigned int previousState = InvalidState;
+        // Seconds since the state was entered, not clip times
+        float currentTime = 0.0f;
+        float previousTime = 0.0f;
+        float blendTime = 0.0f;
+        float blendDuration = 0.0f;
+        // Cycles played by blend space states, the fraction is their normalized time
+        float currentPhase = 0.0f;
+        float previousPhase = 0.0f;
+        float parameters[MaxStateMachineParameters] = {};
+    };
+
+    // Compiled, read-only state machine shared by all its instances.
+    // Every state owns a contiguous run of instructions: each transition is a run of TEST_*
+    // instructions followed by one TRANSITION instruction. A failing test jumps straight
+    // to the first instruction of the next transition.
+    class StateMachine
+    {
+    public:
+        enum class OPCODE : unsigned char
+        {
+            TEST_GREATER,
+            TEST_LESS,
+            TEST_EQUAL,
+            TEST_NOT_EQUAL,
+            TEST_FINISHED,
+            TRANSITION
+        };
+
+        struct Instruction
+        {
+            OPCODE op;
+            unsigned char parameter; // TEST_*: parameter slot
+            unsigned short jump;     // TEST_*: offset to the next transition
+            unsigned int target;     // TRANSITION: destination state
+            float value;             // TEST_*: operand, TRANSITION: blend duration
+        };
+
+        struct State
+        {
+            unsigned int clip;
+            float speed;
+            float startTime; // of the clip, state times count from it
+            float duration;
+            bool looping;
+            unsigned int blendSpace; // NoBlendSpace for clip states
+            unsigned char xParameter;
+            unsigned char yParameter;
+            unsigned int firstInstruction;
+            unsigned int instructionCount;
+        };
+
+        // Resolves clip durations and flattens the definition, called once at load time.
+        // The state machine keeps a reference to the clips it plays and builds its blend spaces.
+        bool Compile(const StateMachineDefinition& definition, const std::vector<ClipHandle>& clips);
+
+        StateMachineInstance CreateInstance() const;
+        StateMachineInstance CreateInstance(unsigned int state) const;
+
+        // Returns -1 if the parameter does not exist
+        int GetParameterIndex(const std::string& name) const;
+        // Returns InvalidState if the state does not exist
+        unsigned int GetStateIndex(const std::string& name) const;
+
+        void SetParameter(StateMachineInstance& instance, unsigned int parameter, float value) const;
+
+        // Advances time and fires transitions for a contiguous range of instances.
+        // Transitions are not tested while a blend is running, they fire once it has finished.
+        void Update(StateMachineInstance* instances, unsigned int count, float deltaTime) const;
+        inline void Update(StateMachineInstance& instance, float deltaTime) const
+        {
+            Update(&instance, 1, deltaTime);
+        }
+
+        // Samples the active state, cross-fading with the previous one while a transition is running.
+        // scratch must be sized like outPose and is only written to while blending.
+        void Sample(const StateMachineInstance& instance, Pose& outPose, Pose& scratch) const;
+
+        // Sample split in two steps for pipelines that blend separately. Writes the active state to
+        // outPose and the previous one to previousPose while a transition is running. Returns the
+        // weight of outPose to pass to Blend(outPose, previousPose, outPose, weight), 1 when not blending.
+        float SampleLayers(const StateMachineInstance& instance, const PoseView& outPose, const PoseView& previousPose) const;
+        // Same as above, only the joints enabled in mask are sampled. mask must be bound with BindMask.
+        float SampleLayers(const StateMachineInstance& instance, const PoseView& outPose, const PoseView& previousPose,
+            const JointMask& mask) const;
+        // Load time, replaces the bindings of mask with every clip of the state machine, each one in
+        // the slot matching its index. Sampling then only reads mask, threads can share it.
+        void BindMask(JointMask& mask) const;
+        inline float SampleLayers(const StateMachineInstance& instance, Pose& outPose, Pose& previousPose) const
+        {
+            if (previousPose.Size() != outPose.Size())
+            {
+                previousPose = outPose;
+            }
+            return SampleLayers(instance, outPose.View(), previousPose.View());
+        }
+
+        inline unsigned int StateCount() const
+        {
+            return static_cast<unsigned int>(mStates.size());
+        }
+
+        inline const State& GetState(unsigned int index) const
+        {
+            return mStates[index];
+        }
+
+    private:
+        float AdvancePhase(const State& state, const StateMachineInstance& instance, float phase, float deltaTime) const;
+        void SampleState(const State& state, const StateMachineInstance& instance, float time, float phase,
+            const PoseView& outPose) const;
+        void SampleState(const State& state, const StateMachineInstance& instance, float time, float phase,
+            const PoseView& outPose, const JointMask& mask) const;
+
+        std::vector<State> mStates;
+        std::vector<Instruction> mInstructions;
+        std::vector<ClipHandle> mClips;
+        std::vector<BlendSpace2D> mBlendSpaces;
+        std::vector<std::string> mStateNames;
+        std::vector<std::string> mParameterNames;
+        unsigned int mDefaultState = 0;
+    };
+}
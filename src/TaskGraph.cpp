@@ -0,0 +1,245 @@
+#include "TaskGraph.h"
+
+#include <cassert>
+#include <iostream>
+
+namespace jobs
+{
+    unsigned int TaskGraph::AddStage(const std::string& name, const std::vector<unsigned int>& inputs,
+        const std::vector<unsigned int>& outputs, StageFunction function, AFFINITY affinity)
+    {
+        Stage stage;
+        stage.name = name;
+        stage.inputs = inputs;
+        stage.outputs = outputs;
+        stage.function = function;
+        stage.affinity = affinity;
+        mStages.push_back(stage);
+        mCompiled = false;
+        return static_cast<unsigned int>(mStages.size() - 1);
+    }
+
+    bool TaskGraph::Compile()
+    {
+        mWorkerStages.clear();
+        mMainStages.clear();
+        mCompiled = false;
+
+        unsigned int stageCount = static_cast<unsigned int>(mStages.size());
+
+        // Resource -> producing stage
+        std::vector<int> producers;
+        for (unsigned int i = 0; i < stageCount; ++i)
+        {
+            for (unsigned int resource : mStages[i].outputs)
+            {
+                if (resource >= producers.size())
+                {
+                    producers.resize(resource + 1, -1);
+                }
+
+                if (producers[resource] >= 0)
+                {
+                    std::cout << "Stages " << mStages[producers[resource]].name << " and " << mStages[i].name
+                        << " produce the same resource\n";
+                    return false;
+                }
+                producers[resource] = i;
+            }
+        }
+
+        // Kahn's algorithm, ties keep the order stages were added in
+        std::vector<std::vector<unsigned int>> dependents(stageCount);
+        std::vector<unsigned int> pending(stageCount, 0);
+        for (unsigned int i = 0; i < stageCount; ++i)
+        {
+            for (unsigned int resource : mStages[i].inputs)
+            {
+                if (resource < producers.size() && producers[resource] >= 0 && producers[resource] != (int)i)
+                {
+                    dependents[producers[resource]].push_back(i);
+                    ++pending[i];
+                }
+            }
+        }
+
+        std::vector<bool> afterMainStage(stageCount, false);
+        std::vector<bool> done(stageCount, false);
+        unsigned int sorted = 0;
+        while (sorted < stageCount)
+        {
+            unsigned int next = stageCount;
+            for (unsigned int i = 0; i < stageCount; ++i)
+            {
+                if (!done[i] && pending[i] == 0)
+                {
+                    next = i;
+                    break;
+                }
+            }
+
+            if (next == stageCount)
+            {
+                std::cout << "Task graph has a cycle\n";
+                return false;
+            }
+
+            const Stage& stage = mStages[next];
+            if (stage.affinity == AFFINITY::MAIN_THREAD)
+            {
+                mMainStages.push_back(stage.function);
+            }
+            else
+            {
+                if (afterMainStage[next])
+                {
+                    std::cout << "Stage " << stage.name << " runs on workers after a main thread stage\n";
+                    return false;
+                }
+                mWorkerStages.push_back(stage.function);
+            }
+
+            done[next] = true;
+            ++sorted;
+            for (unsigned int dependent : dependents[next])
+            {
+                --pending[dependent];
+                if (stage.affinity == AFFINITY::MAIN_THREAD || afterMainStage[next])
+                {
+                    afterMainStage[dependent] = true;
+                }
+            }
+        }
+
+        mCompiled = true;
+        return true;
+    }
+
+    void TaskGraph::RunWorkerStages(void* data, unsigned int begin, unsigned int end)
+    {
+        TaskGraph* graph = static_cast<TaskGraph*>(data);
+        const StageFunction* stages = graph->mWorkerStages.data();
+        unsigned int stageCount = static_cast<unsigned int>(graph->mWorkerStages.size());
+        for (unsigned int item = begin; item < end; ++item)
+        {
+            for (unsigned int i = 0; i < stageCount; ++i)
+            {
+                stages[i](graph->mContext, item);
+            }
+        }
+    }
+
+    unsigned int TaskGraph::SubmitRanges(JobSystem* jobSystem, unsigned int itemCount, unsigned int grainSize)
+    {
+        if (grainSize == 0)
+        {
+            grainSize = 1;
+        }
+
+        if (jobSystem == nullptr || jobSystem->ThreadCount() <= 1)
+        {
+            RunWorkerStages(this, 0, itemCount);
+            return 0;
+        }
+
+        unsigned int rangeCount = (itemCount + grainSize - 1) / grainSize;
+        if (rangeCount > mRangeCapacity)
+        {
+            mRangeCounters.reset(new std::atomic<unsigned int>[rangeCount]);
+            mRangeCapacity = rangeCount;
+        }
+
+        for (unsigned int range = 0; range < rangeCount; ++range)
+        {
+            mRangeCounters[range].store(0, std::memory_order_relaxed);
+            unsigned int begin = range * grainSize;
+            unsigned int end = begin + grainSize < itemCount ? begin + grainSize : itemCount;
+            jobSystem->Submit(&TaskGraph::RunWorkerStages, this, begin, end, mRangeCounters[range]);
+        }
+        return rangeCount;
+    }
+
+    void TaskGraph::Run(JobSystem* jobSystem, unsigned int itemCount, unsigned int grainSize, void* context)
+    {
+        assert(!IsRunning());
+        if (!mCompiled || itemCount == 0)
+        {
+            return;
+        }
+
+        mContext = context;
+        if (grainSize == 0)
+        {
+            grainSize = 1;
+        }
+
+        unsigned int rangeCount = SubmitRanges(jobSystem, itemCount, grainSize);
+        if (rangeCount == 0)
+        {
+            RunMainStages(itemCount, context);
+            return;
+        }
+
+        // Main thread stages consume ranges in order while workers keep going on later ones
+        for (unsigned int range = 0; range < rangeCount; ++range)
+        {
+            jobSystem->Wait(mRangeCounters[range]);
+            unsigned int begin = range * grainSize;
+            unsigned int end = begin + grainSize < itemCount ? begin + grainSize : itemCount;
+            for (unsigned int item = begin; item < end; ++item)
+            {
+                for (StageFunction stage : mMainStages)
+                {
+                    stage(context, item);
+                }
+            }
+        }
+    }
+
+    void TaskGraph::Kick(JobSystem* jobSystem, unsigned int itemCount, unsigned int grainSize, void* context)
+    {
+        assert(!IsRunning());
+        if (!mCompiled || itemCount == 0)
+        {
+            return;
+        }
+
+        mContext = context;
+        mKickedRanges = SubmitRanges(jobSystem, itemCount, grainSize);
+        if (mKickedRanges > 0)
+        {
+            mKickedJobSystem = jobSystem;
+        }
+    }
+
+    void TaskGraph::Wait()
+    {
+        if (!IsRunning())
+        {
+            return;
+        }
+
+        for (unsigned int range = 0; range < mKickedRanges; ++range)
+        {
+            mKickedJobSystem->Wait(mRangeCounters[range]);
+        }
+        mKickedJobSystem = nullptr;
+        mKickedRanges = 0;
+    }
+
+    void TaskGraph::RunMainStages(unsigned int itemCount, void* context)
+    {
+        if (!mCompiled)
+        {
+            return;
+        }
+
+        for (unsigned int item = 0; item < itemCount; ++item)
+        {
+            for (StageFunction stage : mMainStages)
+            {
+                stage(context, item);
+            }
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+
+namespace jobs
+{
+    // Per-item pipeline described as stages reading and writing named resources.
+    // Compile orders the stages from their data dependencies, Run then executes every
+    // worker stage for one item back to back on the same thread, so different items
+    // overlap across cores (item A skinning while item B samples). Stages pinned to the
+    // main thread run on the calling thread as soon as their range of items is ready.
+    class TaskGraph
+    {
+    public:
+        typedef void (*StageFunction)(void* context, unsigned int item);
+
+        enum class AFFINITY
+        {
+            ANY_THREAD,
+            MAIN_THREAD
+        };
+
+        struct Stage
+        {
+            std::string name;
+            std::vector<unsigned int> inputs;
+            std::vector<unsigned int> outputs;
+            StageFunction function = nullptr;
+            AFFINITY affinity = AFFINITY::ANY_THREAD;
+        };
+
+        // A resource can only be produced by one stage, resources nobody produces are external inputs
+        unsigned int AddStage(const std::string& name, const std::vector<unsigned int>& inputs,
+            const std::vector<unsigned int>& outputs, StageFunction function, AFFINITY affinity = AFFINITY::ANY_THREAD);
+
+        // Sorts the stages, fails on cycles, on resources with two producers and on
+        // worker stages that depend on main thread stages
+        bool Compile();
+
+        // Runs every stage for items [0, itemCount), jobSystem may be null
+        void Run(JobSystem* jobSystem, unsigned int itemCount, unsigned int grainSize, void* context);
+
+        // Split version of Run for callers that keep working while the workers run.
+        // Kick queues the worker stages and returns, Wait is the fence for them and must be
+        // called from the same thread before the next Kick or Run. Main thread stages are not
+        // run by either, call RunMainStages once the data they read is safe to touch.
+        void Kick(JobSystem* jobSystem, unsigned int itemCount, unsigned int grainSize, void* context);
+        void Wait();
+        void RunMainStages(unsigned int itemCount, void* context);
+
+        inline bool IsRunning() const
+        {
+            return mKickedJobSystem != nullptr;
+        }
+
+        inline const std::vector<Stage>& GetStages() const
+        {
+            return mStages;
+        }
+
+    private:
+        static void RunWorkerStages(void* data, unsigned int begin, unsigned int end);
+        // Returns the number of ranges submitted, 0 when everything already ran inline
+        unsigned int SubmitRanges(JobSystem* jobSystem, unsigned int itemCount, unsigned int grainSize);
+
+        std::vector<Stage> mStages;
+        // Compiled execution order, split by affinity
+        std::vector<StageFunction> mWorkerStages;
+        std::vector<StageFunction> mMainStages;
+        bool mCompiled = false;
+
+        // Reused between runs so steady state frames do not allocate
+        std::unique_ptr<std::atomic<unsigned int>[]> mRangeCounters;
+        unsigned int mRangeCapacity = 0;
+        void* mContext = nullptr;
+        // Set between Kick and Wait
+        JobSystem* mKickedJobSystem = nullptr;
+        unsigned int mKickedRanges = 0;
+    };
+}
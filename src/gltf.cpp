@@ -6,12 +6,42 @@
 #include "Transform.h"
 #include "Animation.h"
 #include "Skinning.h"
+#include "utils.h"
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
 
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define GLTF_USE_SSE2
+#include <emmintrin.h>
+// SSSE3 is not part of the x64 baseline, it is compiled in and picked at run time
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define GLTF_TARGET_SSSE3
+#else
+#define GLTF_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
 namespace gltf
 {
+    namespace
+    {
+        // Clips loaded under the same name are shared by every caller until the last handle is released
+        std::mutex gSharedClipsMutex;
+        std::map<std::string, std::vector<std::weak_ptr<const animation::Clip>>> gSharedClips;
+
+        // Files cgltf reads through MapFile, keyed by the address it was handed
+        std::mutex gMappedFilesMutex;
+        std::map<const void*, utils::MappedFile> gMappedFiles;
+    }
+
     namespace helper
     {
         math::Transform GetNodeLocalTransform(cgltf_node& node)
@@ -43,31 +73,1005 @@ namespace gltf
             return result;
         }
 
-        int GetNodeIndex(cgltf_node* target, cgltf_node* allNodes, unsigned int numNodes)
-        {
-            if (!target)
+        // cgltf keeps every node in one array, the index is the offset into it
+        int GetNodeIndex(cgltf_node* target, cgltf_node* allNodes, unsigned int numNodes)
+        {
+            if (!target || target < allNodes || target >= allNodes + numNodes)
+            {
+                return -1;
+            }
+
+            return static_cast<int>(target - allNodes);
+        }
+
+        // Skin joint index -> node index, 0 for joints that are not nodes of the file
+        std::vector<int> GetSkinJointNodes(const cgltf_skin& skin, cgltf_node* allNodes, unsigned int numNodes)
+        {
+            unsigned int jointCount = static_cast<unsigned int>(skin.joints_count);
+            std::vector<int> result(jointCount);
+            for (unsigned int i = 0; i < jointCount; ++i)
+            {
+                result[i] = std::max(GetNodeIndex(skin.joints[i], allNodes, numNodes), 0);
+            }
+            return result;
+        }
+
+        // Accessor data when it can be read in bulk, elements are stride bytes apart and hold
+        // componentCount tightly packed components. Null for sparse accessors and padded matrices.
+        const uint8_t* GetAccessorData(const cgltf_accessor& accessor, unsigned int componentCount)
+        {
+            if (accessor.is_sparse || accessor.buffer_view == nullptr ||
+                cgltf_num_components(accessor.type) != componentCount ||
+                cgltf_calc_size(accessor.type, accessor.component_type) != componentCount * cgltf_component_size(accessor.component_type))
+            {
+                return nullptr;
+            }
+
+            const uint8_t* data = cgltf_buffer_view_data(accessor.buffer_view);
+            return data != nullptr ? data + accessor.offset : nullptr;
+        }
+
+        // Integer components to floats, scale is applied after the conversion
+        template <typename T>
+        void ConvertComponents(float* out, const T* in, size_t count, float scale, bool clampToMinusOne)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                float value = static_cast<float>(in[i]) * scale;
+                out[i] = clampToMinusOne && value < -1.0f ? -1.0f : value;
+            }
+        }
+
+#ifdef GLTF_USE_SSE2
+        // Stores 4 converted integers, normalized signed values are clamped to -1
+        inline void StoreComponents(float* out, __m128i values, __m128 scale, bool clampToMinusOne)
+        {
+            __m128 result = _mm_mul_ps(_mm_cvtepi32_ps(values), scale);
+            if (clampToMinusOne)
+            {
+                result = _mm_max_ps(result, _mm_set1_ps(-1.0f));
+            }
+            _mm_storeu_ps(out, result);
+        }
+
+        void ConvertComponents(float* out, const uint8_t* in, size_t count, float scale, bool clampToMinusOne, bool isSigned)
+        {
+            const __m128 scale4 = _mm_set1_ps(scale);
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                __m128i low, high;
+                if (isSigned)
+                {
+                    // Duplicate every byte into the high half of a word, then shift the sign down
+                    low = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+                    high = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+                    StoreComponents(out + i, _mm_srai_epi32(_mm_unpacklo_epi16(low, low), 16), scale4, clampToMinusOne);
+                    StoreComponents(out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(low, low), 16), scale4, clampToMinusOne);
+                    StoreComponents(out + i + 8, _mm_srai_epi32(_mm_unpacklo_epi16(high, high), 16), scale4, clampToMinusOne);
+                    StoreComponents(out + i + 12, _mm_srai_epi32(_mm_unpackhi_epi16(high, high), 16), scale4, clampToMinusOne);
+                }
+                else
+                {
+                    low = _mm_unpacklo_epi8(bytes, zero);
+                    high = _mm_unpackhi_epi8(bytes, zero);
+                    StoreComponents(out + i, _mm_unpacklo_epi16(low, zero), scale4, false);
+                    StoreComponents(out + i + 4, _mm_unpackhi_epi16(low, zero), scale4, false);
+                    StoreComponents(out + i + 8, _mm_unpacklo_epi16(high, zero), scale4, false);
+                    StoreComponents(out + i + 12, _mm_unpackhi_epi16(high, zero), scale4, false);
+                }
+            }
+
+            if (isSigned)
+            {
+                ConvertComponents(out + i, reinterpret_cast<const int8_t*>(in) + i, count - i, scale, clampToMinusOne);
+            }
+            else
+            {
+                ConvertComponents(out + i, in + i, count - i, scale, false);
+            }
+        }
+
+        void ConvertComponents(float* out, const uint16_t* in, size_t count, float scale, bool clampToMinusOne, bool isSigned)
+        {
+            const __m128 scale4 = _mm_set1_ps(scale);
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                if (isSigned)
+                {
+                    StoreComponents(out + i, _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16), scale4, clampToMinusOne);
+                    StoreComponents(out + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16), scale4, clampToMinusOne);
+                }
+                else
+                {
+                    StoreComponents(out + i, _mm_unpacklo_epi16(words, zero), scale4, false);
+                    StoreComponents(out + i + 4, _mm_unpackhi_epi16(words, zero), scale4, false);
+                }
+            }
+
+            if (isSigned)
+            {
+                ConvertComponents(out + i, reinterpret_cast<const int16_t*>(in) + i, count - i, scale, clampToMinusOne);
+            }
+            else
+            {
+                ConvertComponents(out + i, in + i, count - i, scale, false);
+            }
+        }
+#else
+        void ConvertComponents(float* out, const uint8_t* in, size_t count, float scale, bool clampToMinusOne, bool isSigned)
+        {
+            if (isSigned)
+            {
+                ConvertComponents(out, reinterpret_cast<const int8_t*>(in), count, scale, clampToMinusOne);
+            }
+            else
+            {
+                ConvertComponents(out, in, count, scale, false);
+            }
+        }
+
+        void ConvertComponents(float* out, const uint16_t* in, size_t count, float scale, bool clampToMinusOne, bool isSigned)
+        {
+            if (isSigned)
+            {
+                ConvertComponents(out, reinterpret_cast<const int16_t*>(in), count, scale, clampToMinusOne);
+            }
+            else
+            {
+                ConvertComponents(out, in, count, scale, false);
+            }
+        }
+#endif
+
+        // Converts count components of the accessor's component type, resolving normalization once
+        void ConvertComponents(float* out, const uint8_t* in, size_t count, const cgltf_accessor& accessor)
+        {
+            bool normalized = accessor.normalized != 0;
+            switch (accessor.component_type)
+            {
+            case cgltf_component_type_r_32f:
+                memcpy(out, in, count * sizeof(float));
+                break;
+            case cgltf_component_type_r_8u:
+                ConvertComponents(out, in, count, normalized ? 1.0f / 255.0f : 1.0f, false, false);
+                break;
+            case cgltf_component_type_r_8:
+                ConvertComponents(out, in, count, normalized ? 1.0f / 127.0f : 1.0f, normalized, true);
+                break;
+            case cgltf_component_type_r_16u:
+                ConvertComponents(out, reinterpret_cast<const uint16_t*>(in), count, normalized ? 1.0f / 65535.0f : 1.0f, false, false);
+                break;
+            case cgltf_component_type_r_16:
+                ConvertComponents(out, reinterpret_cast<const uint16_t*>(in), count, normalized ? 1.0f / 32767.0f : 1.0f, normalized, true);
+                break;
+            case cgltf_component_type_r_32u:
+                ConvertComponents(out, reinterpret_cast<const uint32_t*>(in), count, 1.0f, false);
+                break;
+            default:
+                memset(out, 0, count * sizeof(float));
+                break;
+            }
+        }
+
+        // Reads every element of the accessor as componentCount floats into out
+        void ReadFloats(float* out, unsigned int componentCount, const cgltf_accessor& accessor)
+        {
+            size_t count = accessor.count;
+            const uint8_t* data = GetAccessorData(accessor, componentCount);
+            if (data == nullptr)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    cgltf_accessor_read_float(&accessor, i, out + i * componentCount, componentCount);
+                }
+                return;
+            }
+
+            size_t elementSize = componentCount * cgltf_component_size(accessor.component_type);
+            if (accessor.stride == elementSize)
+            {
+                ConvertComponents(out, data, count * componentCount, accessor);
+                return;
+            }
+
+            // Interleaved vertex data
+            for (size_t i = 0; i < count; ++i)
+            {
+                ConvertComponents(out + i * componentCount, data + i * accessor.stride, componentCount, accessor);
+            }
+        }
+
+        // Reads an index accessor into count unsigned ints, widening 8 and 16 bit indices
+        void ReadIndices(unsigned int* out, const cgltf_accessor& accessor)
+        {
+            size_t count = accessor.count;
+            const uint8_t* data = GetAccessorData(accessor, 1);
+            size_t componentSize = cgltf_component_size(accessor.component_type);
+            if (data == nullptr || accessor.stride != componentSize)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    out[i] = static_cast<unsigned int>(cgltf_accessor_read_index(&accessor, i));
+                }
+                return;
+            }
+
+            size_t i = 0;
+            switch (accessor.component_type)
+            {
+            case cgltf_component_type_r_32u:
+                memcpy(out, data, count * sizeof(unsigned int));
+                return;
+            case cgltf_component_type_r_16u:
+            {
+                const uint16_t* in = reinterpret_cast<const uint16_t*>(data);
+#ifdef GLTF_USE_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                for (; i + 8 <= count; i += 8)
+                {
+                    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(words, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(words, zero));
+                }
+#endif
+                for (; i < count; ++i)
+                {
+                    out[i] = in[i];
+                }
+                return;
+            }
+            case cgltf_component_type_r_8u:
+            {
+#ifdef GLTF_USE_SSE2
+                const __m128i zero = _mm_setzero_si128();
+                for (; i + 16 <= count; i += 16)
+                {
+                    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+                    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi16(low, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), _mm_unpackhi_epi16(low, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpacklo_epi16(high, zero));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 12), _mm_unpackhi_epi16(high, zero));
+                }
+#endif
+                for (; i < count; ++i)
+                {
+                    out[i] = data[i];
+                }
+                return;
+            }
+            default:
+                for (; i < count; ++i)
+                {
+                    out[i] = static_cast<unsigned int>(cgltf_accessor_read_index(&accessor, i));
+                }
+                return;
+            }
+        }
+
+        // Decodes size bytes from base64 groups starting at in, which must hold enough characters.
+        // Returns false on characters outside the alphabet.
+        bool DecodeBase64Scalar(const char* in, size_t size, uint8_t* out)
+        {
+            unsigned int buffer = 0;
+            unsigned int bufferBits = 0;
+            for (size_t i = 0; i < size; ++i)
+            {
+                while (bufferBits < 8)
+                {
+                    char ch = *in++;
+                    int index =
+                        (unsigned)(ch - 'A') < 26 ? (ch - 'A') :
+                        (unsigned)(ch - 'a') < 26 ? (ch - 'a') + 26 :
+                        (unsigned)(ch - '0') < 10 ? (ch - '0') + 52 :
+                        ch == '+' ? 62 :
+                        ch == '/' ? 63 :
+                        -1;
+                    if (index < 0)
+                    {
+                        return false;
+                    }
+
+                    buffer = (buffer << 6) | index;
+                    bufferBits += 6;
+                }
+
+                out[i] = (unsigned char)(buffer >> (bufferBits - 8));
+                bufferBits -= 8;
+            }
+            return true;
+        }
+
+#ifdef GLTF_USE_SSE2
+        bool HasSSSE3()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+#else
+            return __builtin_cpu_supports("ssse3");
+#endif
+        }
+
+        // Decodes 16 characters into 12 bytes per iteration, classifying characters by their nibbles
+        // (W. Mula, D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions").
+        // Stops 4 bytes before the end of out since every store writes 16 bytes. Returns the number
+        // of bytes decoded, the rest is left to the scalar loop.
+        GLTF_TARGET_SSSE3 size_t DecodeBase64SSSE3(const char* in, size_t size, uint8_t* out, bool& valid)
+        {
+            const __m128i lowNibbleClasses = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+            const __m128i highNibbleClasses = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+            const __m128i offsets = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+            const __m128i slash = _mm_set1_epi8('/');
+            const __m128i packPairs = _mm_set1_epi32(0x01400140);
+            const __m128i packQuads = _mm_set1_epi32(0x00011000);
+            const __m128i packBytes = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            const __m128i zero = _mm_setzero_si128();
+
+            size_t decoded = 0;
+            valid = true;
+            for (; decoded + 16 <= size; decoded += 12, in += 16)
+            {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+                __m128i highNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), nibbleMask);
+                __m128i lowNibbles = _mm_and_si128(chars, nibbleMask);
+                __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lowNibbleClasses, lowNibbles),
+                    _mm_shuffle_epi8(highNibbleClasses, highNibbles));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, zero)) != 0xFFFF)
+                {
+                    valid = false;
+                    return decoded;
+                }
+
+                // '/' shares its high nibble with '+', it is told apart by moving it to the next offset
+                __m128i offset = _mm_shuffle_epi8(offsets, _mm_add_epi8(_mm_cmpeq_epi8(chars, slash), highNibbles));
+                __m128i values = _mm_add_epi8(chars, offset);
+
+                __m128i pairs = _mm_maddubs_epi16(values, packPairs);
+                __m128i quads = _mm_madd_epi16(pairs, packQuads);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + decoded), _mm_shuffle_epi8(quads, packBytes));
+            }
+            return decoded;
+        }
+#endif
+
+        bool DecodeBase64(const char* in, size_t size, uint8_t* out)
+        {
+            size_t decoded = 0;
+#ifdef GLTF_USE_SSE2
+            static const bool hasSSSE3 = HasSSSE3();
+            if (hasSSSE3)
+            {
+                bool valid = true;
+                decoded = DecodeBase64SSSE3(in, size, out, valid);
+                if (!valid)
+                {
+                    return false;
+                }
+            }
+#endif
+            // decoded is a multiple of 3, the scalar loop starts on a group boundary
+            return DecodeBase64Scalar(in + decoded / 3 * 4, size - decoded, out + decoded);
+        }
+
+        // Decodes the base64 data URIs of every buffer before cgltf_load_buffers gets to them.
+        // The output goes straight into the allocation cgltf frees with the data, large buffers
+        // are decoded in parallel chunks.
+        cgltf_result LoadBase64Buffers(cgltf_data* data, jobs::JobSystem* jobSystem)
+        {
+            for (cgltf_size i = 0; i < data->buffers_count; ++i)
+            {
+                cgltf_buffer& buffer = data->buffers[i];
+                if (buffer.data != nullptr || buffer.uri == nullptr || strncmp(buffer.uri, "data:", 5) != 0)
+                {
+                    continue;
+                }
+
+                const char* comma = strchr(buffer.uri, ',');
+                if (comma == nullptr || comma - buffer.uri < 7 || strncmp(comma - 7, ";base64", 7) != 0)
+                {
+                    // cgltf reports the unknown format
+                    continue;
+                }
+
+                const char* base64 = comma + 1;
+                size_t size = buffer.size;
+                if (strlen(base64) < (size * 4 + 2) / 3)
+                {
+                    return cgltf_result_data_too_short;
+                }
+
+                // cgltf releases memory_free buffers with free() when no allocator is set
+                uint8_t* out = static_cast<uint8_t*>(malloc(size > 0 ? size : 1));
+                if (out == nullptr)
+                {
+                    return cgltf_result_out_of_memory;
+                }
+
+                // Whole groups per chunk so every chunk starts on a character boundary
+                const size_t chunkSize = 3 * 64 * 1024;
+                std::atomic<bool> valid{ true };
+                auto decodeChunks = [&](unsigned int begin, unsigned int end)
+                {
+                    for (unsigned int chunk = begin; chunk < end; ++chunk)
+                    {
+                        size_t offset = chunk * chunkSize;
+                        size_t count = size - offset < chunkSize ? size - offset : chunkSize;
+                        if (!DecodeBase64(base64 + offset / 3 * 4, count, out + offset))
+                        {
+                            valid = false;
+                        }
+                    }
+                };
+
+                unsigned int chunkCount = static_cast<unsigned int>((size + chunkSize - 1) / chunkSize);
+                if (jobSystem != nullptr && chunkCount > 1)
+                {
+                    jobSystem->ParallelFor(chunkCount, 1, decodeChunks);
+                }
+                else
+                {
+                    decodeChunks(0, chunkCount);
+                }
+
+                if (!valid)
+                {
+                    free(out);
+                    return cgltf_result_io_error;
+                }
+
+                buffer.data = out;
+                buffer.data_free_method = cgltf_data_free_method_memory_free;
+            }
+            return cgltf_result_success;
+        }
+
+        // EXT_meshopt_compression. The decoders follow the bitstream description of the extension,
+        // every read is bounds checked so a malformed stream fails instead of reading past the buffer.
+        namespace meshopt
+        {
+            const size_t VertexBlockSizeBytes = 8192;
+            const size_t VertexBlockMaxSize = 256;
+            const size_t ByteGroupSize = 16;
+            const size_t VertexTailMinSize = 32;
+
+            // Triangle codes 0xf0 to 0xfd look their second byte up in the last 16 bytes of the stream
+            const size_t CodeAuxTableSize = 16;
+
+            inline uint8_t UnZigZag8(uint8_t v)
+            {
+                return static_cast<uint8_t>(-(v & 1) ^ (v >> 1));
+            }
+
+            inline unsigned int UnZigZag32(unsigned int v)
+            {
+                return (v >> 1) ^ (0u - (v & 1));
+            }
+
+            // One group of 16 byte deltas packed with 0, 2, 4 or 8 bits each. Packed values with every
+            // bit set are escapes, the actual byte follows the packed ones.
+            const uint8_t* DecodeBytesGroup(const uint8_t* data, const uint8_t* end, uint8_t* out, int bitsLog2)
+            {
+                if (bitsLog2 == 0)
+                {
+                    memset(out, 0, ByteGroupSize);
+                    return data;
+                }
+                if (bitsLog2 == 3)
+                {
+                    if (size_t(end - data) < ByteGroupSize)
+                    {
+                        return nullptr;
+                    }
+                    memcpy(out, data, ByteGroupSize);
+                    return data + ByteGroupSize;
+                }
+
+                unsigned int bits = bitsLog2 == 1 ? 2 : 4;
+                size_t packedSize = ByteGroupSize * bits / 8;
+                if (size_t(end - data) < packedSize)
+                {
+                    return nullptr;
+                }
+                const uint8_t* escapes = data + packedSize;
+                unsigned int escape = (1u << bits) - 1;
+                for (size_t i = 0; i < ByteGroupSize; ++i)
+                {
+                    unsigned int shift = 8 - bits - static_cast<unsigned int>(i * bits % 8);
+                    unsigned int value = (data[i * bits / 8] >> shift) & escape;
+                    if (value == escape)
+                    {
+                        if (escapes == end)
+                        {
+                            return nullptr;
+                        }
+                        value = *escapes++;
+                    }
+                    out[i] = static_cast<uint8_t>(value);
+                }
+                return escapes;
+            }
+
+            const uint8_t* DecodeBytes(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t count)
+            {
+                size_t groupCount = count / ByteGroupSize;
+                const uint8_t* header = data;
+                size_t headerSize = (groupCount + 3) / 4;
+                if (size_t(end - data) < headerSize)
+                {
+                    return nullptr;
+                }
+                data += headerSize;
+
+                for (size_t group = 0; group < groupCount && data != nullptr; ++group)
+                {
+                    int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+                    data = DecodeBytesGroup(data, end, out + group * ByteGroupSize, bitsLog2);
+                }
+                return data;
+            }
+
+            // Attributes mode: blocks of vertices, each byte of the vertex stored as its own stream of
+            // zigzag deltas from the previous vertex. The first vertex is stored in the tail.
+            bool DecodeVertices(uint8_t* out, size_t count, size_t stride, const uint8_t* data, size_t size)
+            {
+                size_t tailSize = stride < VertexTailMinSize ? VertexTailMinSize : stride;
+                if (stride == 0 || stride > 256 || stride % 4 != 0 || size < 1 + tailSize || (data[0] & 0xf0) != 0xa0 || (data[0] & 0x0f) != 0)
+                {
+                    return false;
+                }
+
+                const uint8_t* end = data + size - tailSize;
+                uint8_t last[256];
+                memcpy(last, data + size - stride, stride);
+
+                size_t blockSize = (VertexBlockSizeBytes / stride) & ~(ByteGroupSize - 1);
+                blockSize = blockSize < VertexBlockMaxSize ? blockSize : VertexBlockMaxSize;
+
+                uint8_t deltas[VertexBlockMaxSize];
+                const uint8_t* read = data + 1;
+                for (size_t first = 0; first < count; first += blockSize)
+                {
+                    size_t vertexCount = count - first < blockSize ? count - first : blockSize;
+                    size_t alignedCount = (vertexCount + ByteGroupSize - 1) & ~(ByteGroupSize - 1);
+                    uint8_t* vertices = out + first * stride;
+                    for (size_t k = 0; k < stride; ++k)
+                    {
+                        read = DecodeBytes(read, end, deltas, alignedCount);
+                        if (read == nullptr)
+                        {
+                            return false;
+                        }
+
+                        uint8_t value = last[k];
+                        for (size_t i = 0; i < vertexCount; ++i)
+                        {
+                            value = static_cast<uint8_t>(value + UnZigZag8(deltas[i]));
+                            vertices[i * stride + k] = value;
+                        }
+                        last[k] = value;
+                    }
+                }
+                return read == end;
+            }
+
+            // Variable length integer, 7 bits per byte with the high bit set on every byte but the last
+            bool ReadVByte(const uint8_t*& data, const uint8_t* end, unsigned int& value)
+            {
+                value = 0;
+                for (unsigned int shift = 0; shift < 35; shift += 7)
+                {
+                    if (data == end)
+                    {
+                        return false;
+                    }
+                    uint8_t group = *data++;
+                    value |= static_cast<unsigned int>(group & 127) << shift;
+                    if (group < 128)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            inline void WriteIndex(uint8_t* out, size_t i, size_t indexSize, unsigned int index)
+            {
+                if (indexSize == 2)
+                {
+                    reinterpret_cast<uint16_t*>(out)[i] = static_cast<uint16_t>(index);
+                }
+                else
+                {
+                    reinterpret_cast<uint32_t*>(out)[i] = index;
+                }
+            }
+
+            // Triangles mode: each triangle is a code byte referencing the 16 most recent edges and
+            // vertices, the next unseen vertex or a delta coded free index
+            bool DecodeTriangles(uint8_t* out, size_t indexCount, size_t indexSize, const uint8_t* data, size_t size)
+            {
+                if (indexCount % 3 != 0 || (indexSize != 2 && indexSize != 4) || size < 1 + indexCount / 3 + CodeAuxTableSize ||
+                    (data[0] & 0xf0) != 0xe0 || (data[0] & 0x0f) > 1)
+                {
+                    return false;
+                }
+
+                unsigned int edges[16][2];
+                unsigned int vertices[16];
+                memset(edges, -1, sizeof(edges));
+                memset(vertices, -1, sizeof(vertices));
+                size_t edgeOffset = 0;
+                size_t vertexOffset = 0;
+                unsigned int next = 0;
+                unsigned int last = 0;
+                // Version 1 codes 13 and 14 as the free index before and after the last one
+                unsigned int fecMax = (data[0] & 0x0f) >= 1 ? 13 : 15;
+
+                const uint8_t* codes = data + 1;
+                const uint8_t* read = codes + indexCount / 3;
+                const uint8_t* end = data + size - CodeAuxTableSize;
+                const uint8_t* codeAuxTable = end;
+
+                auto pushEdge = [&](unsigned int a, unsigned int b)
+                {
+                    edges[edgeOffset][0] = a;
+                    edges[edgeOffset][1] = b;
+                    edgeOffset = (edgeOffset + 1) & 15;
+                };
+                auto pushVertex = [&](unsigned int v, bool push)
+                {
+                    vertices[vertexOffset] = v;
+                    vertexOffset = (vertexOffset + (push ? 1 : 0)) & 15;
+                };
+                auto readIndex = [&](unsigned int& index)
+                {
+                    unsigned int v;
+                    if (!ReadVByte(read, end, v))
+                    {
+                        return false;
+                    }
+                    last += UnZigZag32(v);
+                    index = last;
+                    return true;
+                };
+
+                for (size_t i = 0; i < indexCount; i += 3)
+                {
+                    uint8_t code = *codes++;
+                    unsigned int a, b, c;
+                    if (code < 0xf0)
+                    {
+                        // Edge from the fifo plus one vertex
+                        unsigned int fe = code >> 4;
+                        a = edges[(edgeOffset - 1 - fe) & 15][0];
+                        b = edges[(edgeOffset - 1 - fe) & 15][1];
+
+                        unsigned int fec = code & 15;
+                        if (fec < fecMax)
+                        {
+                            c = fec == 0 ? next++ : vertices[(vertexOffset - 1 - fec) & 15];
+                            pushVertex(c, fec == 0);
+                        }
+                        else
+                        {
+                            if (fec == 15)
+                            {
+                                if (!readIndex(c))
+                                {
+                                    return false;
+                                }
+                            }
+                            else
+                            {
+                                // 13 and 14 are last - 1 and last + 1
+                                last += fec == 13 ? -1 : 1;
+                                c = last;
+                            }
+                            pushVertex(c, true);
+                        }
+                        pushEdge(c, b);
+                        pushEdge(a, c);
+                    }
+                    else
+                    {
+                        // Three vertices, the first one is next or a free index
+                        unsigned int fea, feb, fec;
+                        if (code < 0xfe)
+                        {
+                            uint8_t codeAux = codeAuxTable[code & 15];
+                            fea = 0;
+                            feb = codeAux >> 4;
+                            fec = codeAux & 15;
+                        }
+                        else
+                        {
+                            if (read == end)
+                            {
+                                return false;
+                            }
+                            uint8_t codeAux = *read++;
+                            fea = code == 0xfe ? 0 : 15;
+                            feb = codeAux >> 4;
+                            fec = codeAux & 15;
+                            // Restarts the vertex numbering, encoded outside the table on purpose
+                            if (codeAux == 0)
+                            {
+                                next = 0;
+                            }
+                        }
+
+                        a = fea == 0 ? next++ : 0;
+                        b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+                        c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+                        if ((fea == 15 && !readIndex(a)) || (feb == 15 && !readIndex(b)) || (fec == 15 && !readIndex(c)))
+                        {
+                            return false;
+                        }
+
+                        pushVertex(a, true);
+                        pushVertex(b, feb == 0 || feb == 15);
+                        pushVertex(c, fec == 0 || fec == 15);
+                        pushEdge(b, a);
+                        pushEdge(c, b);
+                        pushEdge(a, c);
+                    }
+
+                    WriteIndex(out, i + 0, indexSize, a);
+                    WriteIndex(out, i + 1, indexSize, b);
+                    WriteIndex(out, i + 2, indexSize, c);
+                }
+                return read == end;
+            }
+
+            // Indices mode: every index is a zigzag delta from one of two previous indices, the low
+            // bit picks which
+            bool DecodeIndices(uint8_t* out, size_t indexCount, size_t indexSize, const uint8_t* data, size_t size)
+            {
+                const size_t tailSize = 4;
+                if ((indexSize != 2 && indexSize != 4) || size < 1 + indexCount + tailSize ||
+                    (data[0] & 0xf0) != 0xd0 || (data[0] & 0x0f) > 1)
+                {
+                    return false;
+                }
+
+                const uint8_t* read = data + 1;
+                const uint8_t* end = data + size - tailSize;
+                unsigned int last[2] = {};
+                for (size_t i = 0; i < indexCount; ++i)
+                {
+                    unsigned int v;
+                    if (!ReadVByte(read, end, v))
+                    {
+                        return false;
+                    }
+                    unsigned int baseline = v & 1;
+                    last[baseline] += UnZigZag32(v >> 1);
+                    WriteIndex(out, i, indexSize, last[baseline]);
+                }
+                return read == end;
+            }
+
+            // Octahedral normals: x and y are the octahedral coordinates and z holds the length one
+            // is encoded as, the fourth component is left alone
+            template <typename T>
+            void DecodeOctahedral(T* data, size_t count)
+            {
+                const float max = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    T* n = data + i * 4;
+                    float x = static_cast<float>(n[0]);
+                    float y = static_cast<float>(n[1]);
+                    float z = static_cast<float>(n[2]) - fabsf(x) - fabsf(y);
+
+                    // Unfolds the lower hemisphere
+                    float t = z >= 0.0f ? 0.0f : z;
+                    x += x >= 0.0f ? t : -t;
+                    y += y >= 0.0f ? t : -t;
+
+                    float length = sqrtf(x * x + y * y + z * z);
+                    float scale = length > 0.0f ? max / length : 0.0f;
+                    n[0] = static_cast<T>(static_cast<int>(x * scale + (x >= 0.0f ? 0.5f : -0.5f)));
+                    n[1] = static_cast<T>(static_cast<int>(y * scale + (y >= 0.0f ? 0.5f : -0.5f)));
+                    n[2] = static_cast<T>(static_cast<int>(z * scale + (z >= 0.0f ? 0.5f : -0.5f)));
+                }
+            }
+
+            // Quaternions: the three smallest components scaled by sqrt(2), the fourth short holds the
+            // index of the largest component in its low 2 bits and the scale above them
+            void DecodeQuaternions(int16_t* data, size_t count)
+            {
+                const float scale = 1.0f / sqrtf(2.0f);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    int16_t* q = data + i * 4;
+                    float s = scale / static_cast<float>(q[3] | 3);
+                    float x = q[0] * s;
+                    float y = q[1] * s;
+                    float z = q[2] * s;
+                    float ww = 1.0f - x * x - y * y - z * z;
+                    float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+                    int largest = q[3] & 3;
+                    q[(largest + 1) & 3] = static_cast<int16_t>(static_cast<int>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f)));
+                    q[(largest + 2) & 3] = static_cast<int16_t>(static_cast<int>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f)));
+                    q[(largest + 3) & 3] = static_cast<int16_t>(static_cast<int>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f)));
+                    q[largest] = static_cast<int16_t>(static_cast<int>(w * 32767.0f + 0.5f));
+                }
+            }
+
+            // Exponential: a 24 bit signed mantissa and an 8 bit signed exponent to a float
+            void DecodeExponential(uint32_t* data, size_t count)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    int mantissa = static_cast<int>(data[i] << 8) >> 8;
+                    int exponent = static_cast<int>(data[i]) >> 24;
+                    float value = ldexpf(static_cast<float>(mantissa), exponent);
+                    memcpy(&data[i], &value, sizeof(float));
+                }
+            }
+
+            bool DecodeBufferView(uint8_t* out, const cgltf_meshopt_compression& compression)
+            {
+                const uint8_t* data = static_cast<const uint8_t*>(compression.buffer->data) + compression.offset;
+                size_t count = compression.count;
+                size_t stride = compression.stride;
+                bool decoded = false;
+                switch (compression.mode)
+                {
+                case cgltf_meshopt_compression_mode_attributes:
+                    decoded = DecodeVertices(out, count, stride, data, compression.size);
+                    break;
+                case cgltf_meshopt_compression_mode_triangles:
+                    decoded = DecodeTriangles(out, count, stride, data, compression.size);
+                    break;
+                case cgltf_meshopt_compression_mode_indices:
+                    decoded = DecodeIndices(out, count, stride, data, compression.size);
+                    break;
+                default:
+                    break;
+                }
+                if (!decoded)
+                {
+                    return false;
+                }
+
+                switch (compression.filter)
+                {
+                case cgltf_meshopt_compression_filter_octahedral:
+                    if (stride == 4)
+                    {
+                        DecodeOctahedral(reinterpret_cast<int8_t*>(out), count);
+                    }
+                    else
+                    {
+                        DecodeOctahedral(reinterpret_cast<int16_t*>(out), count);
+                    }
+                    break;
+                case cgltf_meshopt_compression_filter_quaternion:
+                    DecodeQuaternions(reinterpret_cast<int16_t*>(out), count);
+                    break;
+                case cgltf_meshopt_compression_filter_exponential:
+                    DecodeExponential(reinterpret_cast<uint32_t*>(out), count * stride / 4);
+                    break;
+                default:
+                    break;
+                }
+                return true;
+            }
+        }
+
+        // Decompresses the buffer views compressed with EXT_meshopt_compression into the view's own
+        // allocation, which cgltf reads instead of the buffer and frees with the data. Views whose
+        // fallback buffer was loaded are left alone. Views decode in parallel on jobSystem.
+        cgltf_result DecodeMeshoptBuffers(cgltf_data* data, jobs::JobSystem* jobSystem)
+        {
+            std::vector<cgltf_buffer_view*> views;
+            for (cgltf_size i = 0; i < data->buffer_views_count; ++i)
+            {
+                cgltf_buffer_view& view = data->buffer_views[i];
+                if (!view.has_meshopt_compression || view.data != nullptr || view.buffer->data != nullptr)
+                {
+                    continue;
+                }
+
+                const cgltf_meshopt_compression& compression = view.meshopt_compression;
+                if (compression.buffer->data == nullptr)
+                {
+                    return cgltf_result_data_too_short;
+                }
+                // Decoders write count * stride bytes, which may be less than the view
+                size_t size = compression.count * compression.stride;
+                view.data = malloc(size > view.size ? size : (view.size > 0 ? view.size : 1));
+                if (view.data == nullptr)
+                {
+                    return cgltf_result_out_of_memory;
+                }
+                memset(view.data, 0, view.size);
+                views.push_back(&view);
+            }
+
+            std::atomic<bool> valid{ true };
+            auto decodeViews = [&](unsigned int begin, unsigned int end)
+            {
+                for (unsigned int i = begin; i < end; ++i)
+                {
+                    if (!meshopt::DecodeBufferView(static_cast<uint8_t*>(views[i]->data), views[i]->meshopt_compression))
+                    {
+                        valid = false;
+                    }
+                }
+            };
+
+            unsigned int viewCount = static_cast<unsigned int>(views.size());
+            if (jobSystem != nullptr && viewCount > 1)
+            {
+                jobSystem->ParallelFor(viewCount, 1, decodeViews);
+            }
+            else
+            {
+                decodeViews(0, viewCount);
+            }
+            return valid ? cgltf_result_success : cgltf_result_invalid_gltf;
+        }
+
+        // cgltf file callbacks that map files instead of reading them. The JSON or GLB container and
+        // every external .bin stay mapped until cgltf_free, buffer views and the GLB binary chunk
+        // point straight into the mappings.
+        cgltf_result MapFile(const cgltf_memory_options*, const cgltf_file_options*, const char* path, cgltf_size* size, void** data)
+        {
+            utils::MappedFile file;
+            if (!file.Open(path))
+            {
+                return cgltf_result_file_not_found;
+            }
+
+            // A size of 0 asks for the whole file, otherwise a buffer of that many bytes
+            cgltf_size requested = (size != nullptr && *size != 0) ? *size : file.Size();
+            if (requested > file.Size())
+            {
+                return cgltf_result_data_too_short;
+            }
+
+            void* mapped = const_cast<unsigned char*>(file.Data());
             {
-                return -1;
+                std::lock_guard<std::mutex> lock(gMappedFilesMutex);
+                gMappedFiles.emplace(mapped, std::move(file));
             }
 
-            for (unsigned int i = 0; i < numNodes; ++i)
+            if (size != nullptr)
             {
-                if (&allNodes[i] == target)
-                {
-                    return i;
-                }
+                *size = requested;
             }
+            *data = mapped;
+            return cgltf_result_success;
+        }
 
-            return -1;
+        void UnmapFile(const cgltf_memory_options*, const cgltf_file_options*, void* data)
+        {
+            std::lock_guard<std::mutex> lock(gMappedFilesMutex);
+            gMappedFiles.erase(data);
         }
 
         void GetScalarValues(std::vector<float>& out, const unsigned int compCount, const cgltf_accessor& inAccessor)
         {
             out.resize(compCount * inAccessor.count);
-
-            for (cgltf_size i = 0; i < inAccessor.count; ++i)
+            if (!out.empty())
             {
-                cgltf_accessor_read_float(&inAccessor, i, &out[i * compCount], compCount);
+                ReadFloats(out.data(), compCount, inAccessor);
             }
         }
 
@@ -98,89 +1102,368 @@ namespace gltf
             assert(compCount == N);
 
             const unsigned int numFrames = (unsigned int)sampler.input->count;
-            result.frames.resize(numFrames);
+            animation::Frame<T>* frames = result.frames.Resize(numFrames);
 
             for (unsigned int i = 0; i < numFrames; ++i)
             {
                 const unsigned int idx = i * compCount;
-                result.frames[i].time = times[i];
-                result.frames[i].in = samplerBicubic ? T(val[idx + N]) : 0.0f;
-                result.frames[i].value = T(val.data() + idx);
-                result.frames[i].out = samplerBicubic ? T(val[idx + N]) : 0.0f;
+                frames[i].time = times[i];
+                frames[i].in = samplerBicubic ? T(val[idx + N]) : 0.0f;
+                frames[i].value = T(val.data() + idx);
+                frames[i].out = samplerBicubic ? T(val[idx + N]) : 0.0f;
             }
         }
 
-        void MeshFromAttributes(skin::AnimatedMesh& mesh, cgltf_attribute& attribute, cgltf_skin* skin,
-            cgltf_node* nodes, unsigned int nodeCount)
+        // Decodes into the presized destination, T must be componentCount tightly packed floats
+        template <typename T>
+        T* ReadAttribute(utils::Array<T>& out, unsigned int componentCount, const cgltf_accessor& accessor)
         {
-            cgltf_attribute_type attribType = attribute.type;
-            cgltf_accessor& accessor = *attribute.data;
+            static_assert(sizeof(T) % sizeof(float) == 0, "Attributes are decoded as floats");
+            assert(sizeof(T) == componentCount * sizeof(float));
+            T* result = out.Resize(accessor.count);
+            if (!out.empty())
+            {
+                ReadFloats(reinterpret_cast<float*>(result), componentCount, accessor);
+            }
+            return result;
+        }
+
+        // Joints are skin relative, relative to the joints array in the gltf file.
+        // They are made relative to the node hierarchy instead through skinJointNodes.
+        void ReadJoints(utils::Array<math::ivec4>& joints, const cgltf_accessor& accessor, const std::vector<int>& skinJointNodes)
+        {
+            size_t count = accessor.count;
+            math::ivec4* out = joints.Resize(count);
+            int jointCount = static_cast<int>(skinJointNodes.size());
+            // Make sure that even the invalid nodes have a value of zero
+            auto remap = [&](int joint)
+            {
+                return joint >= 0 && joint < jointCount ? skinJointNodes[joint] : 0;
+            };
 
-            unsigned int componentCount = 0;
-            switch (accessor.type)
+            const uint8_t* data = GetAccessorData(accessor, 4);
+            if (data != nullptr && accessor.component_type == cgltf_component_type_r_8u)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const uint8_t* joints = data + i * accessor.stride;
+                    out[i] = math::ivec4(remap(joints[0]), remap(joints[1]), remap(joints[2]), remap(joints[3]));
+                }
+            }
+            else if (data != nullptr && accessor.component_type == cgltf_component_type_r_16u)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const uint16_t* joints = reinterpret_cast<const uint16_t*>(data + i * accessor.stride);
+                    out[i] = math::ivec4(remap(joints[0]), remap(joints[1]), remap(joints[2]), remap(joints[3]));
+                }
+            }
+            else
+            {
+                // Add 0.5 to round before casting to integers to avoid errors.
+                float joints[4];
+                for (size_t i = 0; i < count; ++i)
+                {
+                    cgltf_accessor_read_float(&accessor, i, joints, 4);
+                    out[i] = math::ivec4(remap((int)(joints[0] + 0.5f)), remap((int)(joints[1] + 0.5f)),
+                        remap((int)(joints[2] + 0.5f)), remap((int)(joints[3] + 0.5f)));
+                }
+            }
+        }
+
+        void MeshFromAttributes(skin::AnimatedMesh& mesh, cgltf_attribute& attribute, const std::vector<int>& skinJointNodes)
+        {
+            cgltf_accessor& accessor = *attribute.data;
+            switch (attribute.type)
             {
-            case cgltf_type_vec2:
-                componentCount = 2;
+            case cgltf_attribute_type_position:
+                ReadAttribute(mesh.mPositions, 3, accessor);
+                break;
+            case cgltf_attribute_type_texcoord:
+                ReadAttribute(mesh.mTextureCoordinates, 2, accessor);
                 break;
-            case cgltf_type_vec3:
-                componentCount = 3;
+            case cgltf_attribute_type_weights:
+                ReadAttribute(mesh.mWeights, 4, accessor);
+                break;
+            case cgltf_attribute_type_normal:
+            {
+                math::vec3* normals = ReadAttribute(mesh.mNormals, 3, accessor);
+                for (size_t i = 0; i < mesh.mNormals.size(); ++i)
+                {
+                    if (math::lengthSquared(normals[i]) < 0.0000001f)
+                    {
+                        normals[i] = math::vec3(0, 1, 0);
+                    }
+                }
                 break;
-            case cgltf_type_vec4:
-                componentCount = 4;
+            }
+            case cgltf_attribute_type_joints:
+                ReadJoints(mesh.mInfluences, accessor, skinJointNodes);
                 break;
             default:
-                assert(false);
+                // Tangents and colors are not used
+                break;
+            }
+        }
+
+        // KHR_texture_transform, which KHR_mesh_quantization uses to dequantize integer texture coordinates
+        void ApplyTextureTransform(utils::Array<math::vec2>& textureCoordinates, const cgltf_texture_transform& transform)
+        {
+            float c = cosf(transform.rotation);
+            float s = sinf(transform.rotation);
+            math::vec2* coordinates = textureCoordinates.Resize(textureCoordinates.size());
+            for (size_t i = 0; i < textureCoordinates.size(); ++i)
+            {
+                math::vec2& uv = coordinates[i];
+                float u = uv.v[0] * transform.scale[0];
+                float v = uv.v[1] * transform.scale[1];
+                uv = math::vec2(c * u + s * v + transform.offset[0], c * v - s * u + transform.offset[1]);
             }
+        }
 
-            std::vector<float> values;
-            GetScalarValues(values, componentCount, accessor);
-            unsigned int accessorCount = static_cast<unsigned int>(accessor.count);
-            for (unsigned int i = 0; i < accessorCount; ++i)
+        // Time and allocations of the calling thread when a measure started
+        struct Measure
+        {
+            std::chrono::steady_clock::time_point start;
+            unsigned long long allocations = 0;
+            unsigned long long allocatedBytes = 0;
+        };
+
+        Measure StartMeasure(const MeshLoadStats* stats)
+        {
+            Measure measure;
+            if (stats != nullptr)
             {
-                unsigned int index = i * componentCount;
-                switch (attribType)
+                if (stats->countAllocations != nullptr)
                 {
-                case cgltf_attribute_type_position:
-                    mesh.mPositions.push_back(math::vec3(values[index], values[index + 1], values[index + 2]));
-                    break;
-                case cgltf_attribute_type_texcoord:
-                    mesh.mTextureCoordinates.push_back(math::vec2(values[index], values[index + 1]));
-                    break;
-                case cgltf_attribute_type_weights:
-                    mesh.mWeights.push_back(math::vec4(values[index], values[index + 1], values[index + 2], values[index + 3]));
-                    break;
-                case cgltf_attribute_type_normal:
+                    stats->countAllocations(measure.allocations, measure.allocatedBytes);
+                }
+                measure.start = std::chrono::steady_clock::now();
+            }
+            return measure;
+        }
+
+        void EndMeasure(const Measure& measure, const MeshLoadStats* stats, MeshLoadStats::Attribute& attribute)
+        {
+            attribute.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - measure.start).count();
+            ++attribute.accessorCount;
+            if (stats->countAllocations != nullptr)
+            {
+                unsigned long long allocations = 0;
+                unsigned long long allocatedBytes = 0;
+                stats->countAllocations(allocations, allocatedBytes);
+                attribute.allocations += allocations - measure.allocations;
+                attribute.allocatedBytes += allocatedBytes - measure.allocatedBytes;
+            }
+        }
+
+        // Decodes every attribute and the indices of one primitive into mesh
+        void MeshFromPrimitive(skin::AnimatedMesh& mesh, const cgltf_primitive& primitive, const std::vector<int>& skinJointNodes,
+            MeshLoadStats* stats)
+        {
+            unsigned int attributeCount = static_cast<unsigned int>(primitive.attributes_count);
+            for (unsigned int k = 0; k < attributeCount; ++k)
+            {
+                cgltf_attribute* attribute = &primitive.attributes[k];
+                Measure measure = StartMeasure(stats);
+                MeshFromAttributes(mesh, *attribute, skinJointNodes);
+                if (stats != nullptr && attribute->type <= cgltf_attribute_type_weights)
                 {
-                    math::vec3 normal = math::vec3(values[index], values[index + 1], values[index + 2]);
-                    if (math::lengthSquared(normal) < 0.0000001f)
-                    {
-                        normal = math::vec3(0, 1, 0);
-                    }
-                    mesh.mNormals.push_back(normal);
+                    EndMeasure(measure, stats, stats->attributes[attribute->type]);
                 }
-                    break;
-                case cgltf_attribute_type_joints:
-                    // Indices are skin relative, relative to the joints array in the gltf file
-                    // We need to make them relative to node hierarchy instead.
-                    // Add 0.5 to round before casting to integers to avoid errors.
-                    math::ivec4 joint((int)(values[index] + 0.5f), (int)(values[index + 1] + 0.5f),
-                        (int)(values[index + 2] + 0.5f), (int)(values[index + 3] + 0.5f));
-                    for (unsigned int j = 0; j < 4; ++j)
+            }
+
+            // The sample only samples the base color texture
+            const cgltf_material* material = primitive.material;
+            if (material != nullptr && material->has_pbr_metallic_roughness && material->pbr_metallic_roughness.base_color_texture.has_transform)
+            {
+                ApplyTextureTransform(mesh.mTextureCoordinates, material->pbr_metallic_roughness.base_color_texture.transform);
+            }
+
+            Measure measure = StartMeasure(stats);
+            unsigned int indicesCount = primitive.indices != nullptr ? static_cast<unsigned int>(primitive.indices->count) : 0;
+            unsigned int* indices = mesh.mIndices.Resize(indicesCount);
+            if (indicesCount > 0)
+            {
+                ReadIndices(indices, *primitive.indices);
+            }
+            if (stats != nullptr)
+            {
+                EndMeasure(measure, stats, stats->indices);
+            }
+        }
+
+        // Bind transform of every joint of skin, in the order of its joints array
+        void GetSkinBindTransforms(std::vector<math::Transform>& out, const cgltf_skin& skin)
+        {
+            unsigned int jointCount = static_cast<unsigned int>(skin.joints_count);
+            out.assign(jointCount, math::Transform());
+            if (skin.inverse_bind_matrices == nullptr)
+            {
+                return;
+            }
+
+            std::vector<float> invBindMatrices;
+            GetScalarValues(invBindMatrices, 16, *skin.inverse_bind_matrices);
+            jointCount = std::min(jointCount, static_cast<unsigned int>(invBindMatrices.size() / 16));
+            for (unsigned int j = 0; j < jointCount; ++j)
+            {
+                math::mat4 invBindMatrix = math::mat4(&(invBindMatrices[j * 16]));
+                out[j] = TransformFromMatrix(inverse(invBindMatrix));
+            }
+        }
+
+        // Joints covered by a skin take its bind transform, later skins win, the others keep their
+        // rest transform. skinBindTransforms holds GetSkinBindTransforms of every skin.
+        animation::Pose BindPoseFromSkins(const animation::Pose& restPose, const std::vector<std::vector<math::Transform>>& skinBindTransforms,
+            cgltf_data* data)
+        {
+            unsigned int boneCount = restPose.Size();
+            std::vector<math::Transform> worldBindPoses(boneCount);
+            for (unsigned int i = 0; i < boneCount; ++i)
+            {
+                worldBindPoses[i] = restPose.GlobalTransform(i);
+            }
+
+            for (unsigned int i = 0; i < skinBindTransforms.size(); ++i)
+            {
+                const cgltf_skin& skin = data->skins[i];
+                for (unsigned int j = 0; j < skinBindTransforms[i].size(); ++j)
+                {
+                    int jointIndex = GetNodeIndex(skin.joints[j], data->nodes, boneCount);
+                    if (jointIndex >= 0)
                     {
-                        // Make sure that even the invalid nodes have a value of zero
-                        joint.v[j] = std::max(GetNodeIndex(skin->joints[joint.v[j]], nodes, nodeCount), 0);
+                        worldBindPoses[jointIndex] = skinBindTransforms[i][j];
                     }
-                    mesh.mInfluences.push_back(joint);
-                    break;
                 }
             }
+
+            // Move each joint to the local space of its parent
+            animation::Pose bindPose = restPose;
+            for (unsigned int i = 0; i < boneCount; ++i)
+            {
+                int p = bindPose.parents[i];
+                if (p >= 0)
+                {
+                    bindPose.joints[i] = math::combine(math::inverse(worldBindPoses[p]), worldBindPoses[i]);
+                }
+            }
+            return bindPose;
+        }
+
+        // Adds a track to clip for every node animation animates and returns the track each channel
+        // writes to, -1 for skipped channels. When several channels animate the same property of a
+        // node only the last one is kept, so every kept channel can be decoded independently.
+        std::vector<int> LayoutClipTracks(animation::Clip& clip, const cgltf_animation& animation, cgltf_data* data,
+            std::vector<int>& nodeToTrack)
+        {
+            unsigned int nodeCount = static_cast<unsigned int>(data->nodes_count);
+            nodeToTrack.assign(nodeCount, -1);
+            if (animation.name != nullptr)
+            {
+                clip.name = animation.name;
+            }
+
+            unsigned int channelCount = static_cast<unsigned int>(animation.channels_count);
+            std::vector<int> channelTracks(channelCount, -1);
+            // Track * 3 + path -> last channel writing it
+            std::vector<int> lastChannel;
+            for (unsigned int j = 0; j < channelCount; ++j)
+            {
+                const cgltf_animation_channel& channel = animation.channels[j];
+                int path = static_cast<int>(channel.target_path) - cgltf_animation_path_type_translation;
+                int nodeIndex = GetNodeIndex(channel.target_node, data->nodes, nodeCount);
+                if (nodeIndex < 0 || path < 0 || path > 2)
+                {
+                    // TODO-weights?
+                    continue;
+                }
+
+                if (nodeToTrack[nodeIndex] < 0)
+                {
+                    nodeToTrack[nodeIndex] = static_cast<int>(clip.tracks.size());
+                    clip.AddTrack(nodeIndex);
+                    lastChannel.resize(clip.tracks.size() * 3, -1);
+                }
+
+                int& last = lastChannel[nodeToTrack[nodeIndex] * 3 + path];
+                if (last >= 0)
+                {
+                    channelTracks[last] = -1;
+                }
+                last = static_cast<int>(j);
+                channelTracks[j] = nodeToTrack[nodeIndex];
+            }
+            return channelTracks;
+        }
+
+        void TrackFromChannel(animation::TransformTrack& result, const cgltf_animation_channel& channel)
+        {
+            if (channel.target_path == cgltf_animation_path_type_translation)
+            {
+                TrackFromChannel<math::vec3, 3>(result.position, channel);
+                result.position.UpdateIndexLookupTable();
+            }
+            else if (channel.target_path == cgltf_animation_path_type_rotation)
+            {
+                TrackFromChannel<math::Quaternion, 4>(result.rotation, channel);
+                result.rotation.UpdateIndexLookupTable();
+            }
+            else if (channel.target_path == cgltf_animation_path_type_scale)
+            {
+                TrackFromChannel<math::vec3, 3>(result.scale, channel);
+                result.scale.UpdateIndexLookupTable();
+            }
+        }
+
+        // Fills clips with the live clips shared under sharedName, returns false if there are none
+        bool FindSharedClips(std::vector<animation::ClipHandle>& clips, const char* sharedName, unsigned int clipCount)
+        {
+            if (sharedName == nullptr)
+            {
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(gSharedClipsMutex);
+            auto it = gSharedClips.find(sharedName);
+            if (it == gSharedClips.end() || it->second.size() != clipCount)
+            {
+                return false;
+            }
+
+            std::vector<animation::ClipHandle> shared(clipCount);
+            for (unsigned int i = 0; i < clipCount; ++i)
+            {
+                shared[i] = it->second[i].lock();
+                if (shared[i] == nullptr)
+                {
+                    return false;
+                }
+            }
+            clips = std::move(shared);
+            return true;
+        }
+
+        // Shares freshly loaded clips under sharedName. Clips are loaded without holding the lock, if
+        // another thread shared the same name in the meantime its clips replace ours.
+        void ShareClips(std::vector<animation::ClipHandle>& clips, const char* sharedName)
+        {
+            if (sharedName == nullptr || FindSharedClips(clips, sharedName, static_cast<unsigned int>(clips.size())))
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(gSharedClipsMutex);
+            gSharedClips[sharedName].assign(clips.begin(), clips.end());
         }
     }
 
-    cgltf_data* LoadGLTFFile(const char* filePath)
+    cgltf_data* LoadGLTFFile(const char* filePath, jobs::JobSystem* jobSystem)
     {
         cgltf_options options;
         memset(&options, 0, sizeof(cgltf_options));
+        options.file.read = &helper::MapFile;
+        options.file.release = &helper::UnmapFile;
 
         cgltf_data* data = NULL;
         cgltf_result result = cgltf_parse_file(&options, filePath, &data);
@@ -191,7 +1474,11 @@ namespace gltf
             return nullptr;
         }
 
-        result = cgltf_load_buffers(&options, data, filePath);
+        result = helper::LoadBase64Buffers(data, jobSystem);
+        if (result == cgltf_result_success)
+        {
+            result = cgltf_load_buffers(&options, data, filePath);
+        }
         if (result != cgltf_result_success)
         {
             cgltf_free(data);
@@ -208,6 +1495,15 @@ namespace gltf
             return nullptr;
         }
 
+        // After validation, which checks the compressed ranges against their buffers
+        result = helper::DecodeMeshoptBuffers(data, jobSystem);
+        if (result != cgltf_result_success)
+        {
+            cgltf_free(data);
+            std::cout << "Could not decompress " << filePath << std::endl;
+            return nullptr;
+        }
+
         return data;
     }
 
@@ -224,6 +1520,47 @@ namespace gltf
         }
     }
 
+    uint64_t HashSource(const char* filePath)
+    {
+        utils::MappedFile file;
+        if (!file.Open(filePath))
+        {
+            return 0;
+        }
+
+        uint64_t hash = utils::HashFNV1a(&LoaderVersion, sizeof(LoaderVersion));
+        hash = utils::HashFNV1a(file.Data(), file.Size(), hash);
+
+        // Only the JSON is parsed, to find the external buffers
+        cgltf_options options;
+        memset(&options, 0, sizeof(cgltf_options));
+        cgltf_data* data = nullptr;
+        if (cgltf_parse(&options, file.Data(), file.Size(), &data) == cgltf_result_success)
+        {
+            std::string directory = filePath;
+            size_t separator = directory.find_last_of("/\\");
+            directory = separator == std::string::npos ? std::string() : directory.substr(0, separator + 1);
+            for (cgltf_size i = 0; i < data->buffers_count; ++i)
+            {
+                const char* uri = data->buffers[i].uri;
+                if (uri == nullptr || strncmp(uri, "data:", 5) == 0)
+                {
+                    continue;
+                }
+
+                std::string decoded = uri;
+                decoded.resize(cgltf_decode_uri(&decoded[0]));
+                utils::MappedFile buffer;
+                if (buffer.Open((directory + decoded).c_str()))
+                {
+                    hash = utils::HashFNV1a(buffer.Data(), buffer.Size(), hash);
+                }
+            }
+            cgltf_free(data);
+        }
+        return hash != 0 ? hash : 1;
+    }
+
     animation::Pose LoadRestPose(cgltf_data* data)
     {
         unsigned int boneCount = (unsigned int)data->nodes_count;
@@ -241,54 +1578,16 @@ namespace gltf
         return std::move(result);
     }
 
-    // TODO: This needs to be optimized
     animation::Pose LoadBindPose(cgltf_data* data)
     {
-        animation::Pose restPose = LoadRestPose(data);
-        unsigned int boneCount = restPose.Size();
-        std::vector<math::Transform> worldBindPoses(boneCount);
-        // Default initialization
-        for (unsigned int i = 0; i < boneCount; ++i)
-        {
-            worldBindPoses[i] = restPose.GlobalTransform(i);
-        }
-
         // Load inverse bind matrices from gltf file and convert them to bind matrices
-        // Loop through each skinned mesh in the gltf file
         unsigned int skinCount = (unsigned int)data->skins_count;
+        std::vector<std::vector<math::Transform>> skinBindTransforms(skinCount);
         for (unsigned int i = 0; i < skinCount; ++i)
-        { 
-            cgltf_skin* skin = &(data->skins[i]);
-            std::vector<float> invBindMatrices;
-            helper::GetScalarValues(invBindMatrices, 16, *skin->inverse_bind_matrices);
-
-            unsigned int jointCount = (unsigned int)skin->joints_count;
-            for (unsigned int j = 0; j < jointCount; ++j)
-            {
-                cgltf_node* jointNode = skin->joints[j];
-                unsigned int jointIndex = helper::GetNodeIndex(jointNode, data->nodes, boneCount);
-                float* matrix = &(invBindMatrices[j * 16]);
-                math::mat4 invBindMatrix = math::mat4(matrix);
-                math::mat4 bindMatrix = inverse(invBindMatrix);
-                math::Transform bindTransform = TransformFromMatrix(bindMatrix);
-                worldBindPoses[jointIndex] = bindTransform;
-            }
-        }
-
-        // Move each joint to the local space of its parent
-        animation::Pose bindPose = restPose;
-        for (unsigned int i = 0; i < boneCount; ++i)
         {
-            int p = bindPose.parents[i];
-            if (p >= 0)
-            {
-                math::Transform parentTransform = worldBindPoses[p];
-                math::Transform currentTransform = worldBindPoses[i];
-                currentTransform = math::combine(math::inverse(parentTransform), currentTransform);
-                bindPose.joints[i] = currentTransform;
-            }
+            helper::GetSkinBindTransforms(skinBindTransforms[i], data->skins[i]);
         }
-        return bindPose;
+        return helper::BindPoseFromSkins(LoadRestPose(data), skinBindTransforms, data);
     }
 
     std::vector<std::string> LoadJointNames(cgltf_data* data)
@@ -311,47 +1610,35 @@ namespace gltf
         return result;
     }
 
-    void LoadAnimationClips(std::vector<animation::Clip>& clips, cgltf_data* data)
+    void LoadAnimationClips(std::vector<animation::ClipHandle>& clips, cgltf_data* data, const char* sharedName)
     {
         unsigned int clipCount = (unsigned int)data->animations_count;
-        unsigned int nodeCount = (unsigned int)data->nodes_count;
+        if (helper::FindSharedClips(clips, sharedName, clipCount))
+        {
+            return;
+        }
 
         clips.resize(clipCount);
 
+        // Node index -> track index of the clip being loaded
+        std::vector<int> nodeToTrack;
         for (unsigned int i = 0; i < clipCount; ++i)
         {
-            clips[i].name = data->animations[i].name;
-            unsigned int animationChannelCount = (unsigned int)data->animations[i].channels_count;
-            for (unsigned int j = 0; j < animationChannelCount; ++j)
+            animation::Clip clip;
+            const cgltf_animation& animation = data->animations[i];
+            std::vector<int> channelTracks = helper::LayoutClipTracks(clip, animation, data, nodeToTrack);
+            for (unsigned int j = 0; j < channelTracks.size(); ++j)
             {
-                cgltf_animation_channel& channel = data->animations[i].channels[j];
-                cgltf_node* target = channel.target_node;
-                int nodeIndex = helper::GetNodeIndex(target, data->nodes, nodeCount);
-
-                if (channel.target_path == cgltf_animation_path_type_translation)
-                {
-                    animation::VectorTrack& track = clips[i][nodeIndex].position;
-                    helper::TrackFromChannel<math::vec3, 3>(track, channel);
-                    track.UpdateIndexLookupTable();
-                }
-                else if (channel.target_path == cgltf_animation_path_type_rotation)
-                {
-                    animation::QuaternionTrack& track = clips[i][nodeIndex].rotation;
-                    helper::TrackFromChannel<math::Quaternion, 4>(track, channel);
-                    track.UpdateIndexLookupTable();
-                }
-                else if (channel.target_path == cgltf_animation_path_type_scale)
+                if (channelTracks[j] >= 0)
                 {
-                    animation::VectorTrack& track = clips[i][nodeIndex].scale;
-                    helper::TrackFromChannel<math::vec3, 3>(track, channel);
-                    track.UpdateIndexLookupTable();
+                    helper::TrackFromChannel(clip.tracks[channelTracks[j]], animation.channels[j]);
                 }
-                // TODO-weights?
             }
-            clips[i].RecalculateDuration();
-            clips[i].looping = true;
-            // TOOD - clip looping ?
+            clip.RecalculateDuration();
+            clips[i] = std::make_shared<const animation::Clip>(std::move(clip));
         }
+
+        helper::ShareClips(clips, sharedName);
     }
 
     skin::Skeleton LoadSkeleton(cgltf_data* data)
@@ -377,28 +1664,162 @@ namespace gltf
             {
                 continue;
             }
+            std::vector<int> skinJointNodes = helper::GetSkinJointNodes(*node->skin, nodes, nodeCount);
             unsigned int primitiveCount = static_cast<unsigned int>(node->mesh->primitives_count);
             for (unsigned int j = 0; j < primitiveCount; ++j)
             {
                 meshes.push_back(skin::AnimatedMesh());
-                skin::AnimatedMesh& mesh = meshes[meshes.size() - 1];
-                cgltf_primitive* primitive = &node->mesh->primitives[j];
-                unsigned int attributeCount = static_cast<unsigned int>(primitive->attributes_count);
-                for (unsigned int k = 0; k < attributeCount; ++k)
+                helper::MeshFromPrimitive(meshes[meshes.size() - 1], node->mesh->primitives[j], skinJointNodes, nullptr);
+            }
+        }
+    }
+
+    void LoadScene(skin::Skeleton& skeleton, std::vector<animation::ClipHandle>& clips, std::vector<skin::AnimatedMesh>& meshes,
+        cgltf_data* data, jobs::JobSystem& jobSystem, const char* sharedName, MeshLoadStats* stats)
+    {
+        enum class TASK
+        {
+            PRIMITIVE, // a: mesh slot, b: node, c: primitive
+            CHANNEL,   // a: clip, b: channel, c: track
+            SKIN       // a: skin
+        };
+
+        struct Task
+        {
+            TASK kind;
+            unsigned int a;
+            unsigned int b;
+            unsigned int c;
+        };
+
+        // Everything a task writes to is sized here, so the result does not depend on the order they run in
+        std::vector<Task> tasks;
+        cgltf_node* nodes = data->nodes;
+        unsigned int nodeCount = static_cast<unsigned int>(data->nodes_count);
+        std::vector<std::vector<int>> skinJointNodes(nodeCount);
+        size_t firstMesh = meshes.size();
+        unsigned int meshSlot = static_cast<unsigned int>(firstMesh);
+        for (unsigned int i = 0; i < nodeCount; ++i)
+        {
+            cgltf_node* node = &nodes[i];
+            if (node->mesh == nullptr || node->skin == nullptr)
+            {
+                continue;
+            }
+            skinJointNodes[i] = helper::GetSkinJointNodes(*node->skin, nodes, nodeCount);
+            for (unsigned int j = 0; j < node->mesh->primitives_count; ++j)
+            {
+                tasks.push_back({ TASK::PRIMITIVE, meshSlot++, i, j });
+            }
+        }
+        meshes.resize(meshSlot);
+        // Each primitive measures into its own stats, summed once every task ran
+        std::vector<MeshLoadStats> primitiveStats(stats != nullptr ? meshSlot - firstMesh : 0);
+        for (MeshLoadStats& primitive : primitiveStats)
+        {
+            primitive.countAllocations = stats->countAllocations;
+        }
+
+        unsigned int clipCount = static_cast<unsigned int>(data->animations_count);
+        bool sharedClips = helper::FindSharedClips(clips, sharedName, clipCount);
+        std::vector<animation::Clip> loadedClips(sharedClips ? 0 : clipCount);
+        std::vector<int> nodeToTrack;
+        for (unsigned int i = 0; i < loadedClips.size(); ++i)
+        {
+            std::vector<int> channelTracks = helper::LayoutClipTracks(loadedClips[i], data->animations[i], data, nodeToTrack);
+            for (unsigned int j = 0; j < channelTracks.size(); ++j)
+            {
+                if (channelTracks[j] >= 0)
                 {
-                    cgltf_attribute* attribute = &primitive->attributes[k];
-                    helper::MeshFromAttributes(mesh, *attribute, node->skin, nodes, nodeCount);
+                    tasks.push_back({ TASK::CHANNEL, i, j, static_cast<unsigned int>(channelTracks[j]) });
                 }
-            
-                unsigned int indicesCount = static_cast<unsigned int>(primitive->indices->count);
-                mesh.mIndices.resize(indicesCount);
-                for (unsigned int k = 0; k < indicesCount; ++k)
+            }
+        }
+
+        unsigned int skinCount = static_cast<unsigned int>(data->skins_count);
+        std::vector<std::vector<math::Transform>> skinBindTransforms(skinCount);
+        for (unsigned int i = 0; i < skinCount; ++i)
+        {
+            tasks.push_back({ TASK::SKIN, i, 0, 0 });
+        }
+
+        auto runTasks = [&](unsigned int begin, unsigned int end)
+        {
+            for (unsigned int t = begin; t < end; ++t)
+            {
+                const Task& task = tasks[t];
+                switch (task.kind)
                 {
-                    mesh.mIndices[k] = static_cast<unsigned int>(cgltf_accessor_read_index(primitive->indices, k));
+                case TASK::PRIMITIVE:
+                    helper::MeshFromPrimitive(meshes[task.a], nodes[task.b].mesh->primitives[task.c], skinJointNodes[task.b],
+                        stats != nullptr ? &primitiveStats[task.a - firstMesh] : nullptr);
+                    break;
+                case TASK::CHANNEL:
+                    helper::TrackFromChannel(loadedClips[task.a].tracks[task.c], data->animations[task.a].channels[task.b]);
+                    break;
+                case TASK::SKIN:
+                    helper::GetSkinBindTransforms(skinBindTransforms[task.a], data->skins[task.a]);
+                    break;
                 }
-                mesh.UpdateGPUBuffers();
             }
+        };
+        // One task per job, unless that would fill the queue and run the rest inline on this thread
+        unsigned int taskCount = static_cast<unsigned int>(tasks.size());
+        jobSystem.ParallelFor(taskCount, taskCount / (jobs::WorkQueue::Capacity / 2) + 1, runTasks);
+        for (const MeshLoadStats& primitive : primitiveStats)
+        {
+            stats->Add(primitive);
+        }
+
+        skeleton.restPose = LoadRestPose(data);
+        skeleton.bindPose = helper::BindPoseFromSkins(skeleton.restPose, skinBindTransforms, data);
+        skeleton.jointNames = LoadJointNames(data);
+        skeleton.UpdateInverseBindPose();
+
+        if (!sharedClips)
+        {
+            clips.resize(clipCount);
+            for (unsigned int i = 0; i < clipCount; ++i)
+            {
+                loadedClips[i].RecalculateDuration();
+                clips[i] = std::make_shared<const animation::Clip>(std::move(loadedClips[i]));
+            }
+            helper::ShareClips(clips, sharedName);
         }
     }
-}
 
+    void MeshLoadStats::Add(const MeshLoadStats& other)
+    {
+        auto add = [](Attribute& to, const Attribute& from)
+        {
+            to.accessorCount += from.accessorCount;
+            to.allocations += from.allocations;
+            to.allocatedBytes += from.allocatedBytes;
+            to.milliseconds += from.milliseconds;
+        };
+        for (unsigned int i = 0; i <= cgltf_attribute_type_weights; ++i)
+        {
+            add(attributes[i], other.attributes[i]);
+        }
+        add(indices, other.indices);
+    }
+
+    void MeshLoadStats::Print(unsigned int loadCount) const
+    {
+        const char* names[] = { "invalid", "position", "normal", "tangent", "texcoord", "color", "joints", "weights", "indices" };
+        for (unsigned int i = 0; i <= cgltf_attribute_type_weights + 1; ++i)
+        {
+            const Attribute& attribute = i <= cgltf_attribute_type_weights ? attributes[i] : indices;
+            if (attribute.accessorCount == 0)
+            {
+                continue;
+            }
+            std::cout << "  " << names[i] << ": " << attribute.accessorCount / loadCount << " accessors, " << attribute.milliseconds / loadCount << " ms";
+            if (countAllocations != nullptr)
+            {
+                std::cout << ", " << attribute.allocations / loadCount << " allocations, " << attribute.allocatedBytes / loadCount << " bytes allocated";
+            }
+            std::cout << "\n";
+        }
+    }
+}
@@ -1,16 +1,61 @@
 #pragma once
 #include "cgltf.h"
 #include "Animation.h"
+#include "JobSystem.h"
 #include "Skinning.h"
 
 namespace gltf
 {
-    cgltf_data* LoadGLTFFile(const char* filePath);
+    // Bump on every loader change that changes what the loaders output, so files cooked from the
+    // same source by an older loader are cooked again
+    constexpr uint32_t LoaderVersion = 1;
+
+    // Where mesh loading spends its time, filled in by LoadScene when asked for. Times are summed over
+    // the jobs decoding the primitives.
+    struct MeshLoadStats
+    {
+        // Returns how many allocations the calling thread made so far and their total size
+        typedef void (*AllocationCounter)(unsigned long long& allocations, unsigned long long& bytes);
+
+        struct Attribute
+        {
+            unsigned int accessorCount = 0;
+            unsigned long long allocations = 0;
+            unsigned long long allocatedBytes = 0;
+            double milliseconds = 0.0;
+        };
+
+        // Indexed by cgltf_attribute_type
+        Attribute attributes[cgltf_attribute_type_weights + 1];
+        Attribute indices;
+        // Allocations are only counted by programs counting them in their global operator new, see the
+        // cooker --benchmark
+        AllocationCounter countAllocations = nullptr;
+
+        void Add(const MeshLoadStats& other);
+        // Averaged over loadCount loads
+        void Print(unsigned int loadCount = 1) const;
+    };
+
+    // Loads .gltf and .glb files. The file and its external buffers are memory mapped until
+    // FreeGLTFFile, embedded base64 buffers are decoded on jobSystem when one is given, call from
+    // its owning thread
+    cgltf_data* LoadGLTFFile(const char* filePath, jobs::JobSystem* jobSystem = nullptr);
     void FreeGLTFFile(cgltf_data*& handle);
+    // Hashes a .gltf or .glb file, the external buffers it references and LoaderVersion. Returns 0 if
+    // the file can not be read.
+    uint64_t HashSource(const char* filePath);
     animation::Pose LoadRestPose(cgltf_data* data);
     animation::Pose LoadBindPose(cgltf_data* data);
     std::vector<std::string> LoadJointNames(cgltf_data* data);
-    void LoadAnimationClips(std::vector<animation::Clip>& clips, cgltf_data* data);
+    // Clips are immutable, passing a sharedName (usually the file path) returns the clips
+    // already loaded under that name instead of new copies
+    void LoadAnimationClips(std::vector<animation::ClipHandle>& clips, cgltf_data* data, const char* sharedName = nullptr);
     skin::Skeleton LoadSkeleton(cgltf_data* data);
     void LoadMeshes(std::vector<skin::AnimatedMesh>& meshes, cgltf_data* data);
+    // LoadSkeleton, LoadAnimationClips and LoadMeshes in one go, with every mesh primitive, skin and
+    // animation channel decoded as its own job on jobSystem. The output is the same as theirs whatever
+    // order the jobs run in. Can be called from a job. Adds the cost of every mesh attribute to stats when given.
+    void LoadScene(skin::Skeleton& skeleton, std::vector<animation::ClipHandle>& clips, std::vector<skin::AnimatedMesh>& meshes,
+        cgltf_data* data, jobs::JobSystem& jobSystem, const char* sharedName = nullptr, MeshLoadStats* stats = nullptr);
 }
\ No newline at end of file
@@ -2,6 +2,18 @@
 
 #include <fstream>
 #include <sstream>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace utils
 {
@@ -21,4 +33,105 @@ namespace utils
         file.close();
         return result;
     }
-}
\ No newline at end of file
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+        : mData(other.mData), mSize(other.mSize)
+    {
+        other.mData = nullptr;
+        other.mSize = 0;
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+            std::swap(mData, other.mData);
+            std::swap(mSize, other.mSize);
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    bool MappedFile::Open(const char* path)
+    {
+        Close();
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        // The view keeps the mapping and the file open, the handles are not needed past this point
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr)
+        {
+            return false;
+        }
+
+        mData = static_cast<const unsigned char*>(view);
+        mSize = (size_t)size.QuadPart;
+#else
+        int file = open(path, O_RDONLY);
+        if (file < 0)
+        {
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(file, &info) != 0 || info.st_size == 0)
+        {
+            close(file);
+            return false;
+        }
+
+        void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (view == MAP_FAILED)
+        {
+            return false;
+        }
+
+        mData = static_cast<const unsigned char*>(view);
+        mSize = (size_t)info.st_size;
+#endif
+        return true;
+    }
+
+    void MappedFile::Close()
+    {
+        if (mData == nullptr)
+        {
+            return;
+        }
+
+#ifdef _WIN32
+        UnmapViewOfFile(mData);
+#else
+        munmap(const_cast<unsigned char*>(mData), mSize);
+#endif
+        mData = nullptr;
+        mSize = 0;
+    }
+}
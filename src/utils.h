@@ -1,7 +1,172 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 namespace utils
 {
     std::string ReadFile(const char* path); 
-}
\ No newline at end of file
+
+    constexpr uint64_t FNV1aOffset = 14695981039346656037ull;
+    constexpr uint64_t FNV1aPrime = 1099511628211ull;
+
+    // 64-bit FNV-1a, pass the previous result as hash to continue over several blocks
+    inline uint64_t HashFNV1a(const void* data, size_t size, uint64_t hash = FNV1aOffset)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * FNV1aPrime;
+        }
+        return hash;
+    }
+
+    // Read-only view of a whole file. Pages are read in by the OS on first access, so mapping a
+    // large file costs nothing until it is touched and never keeps a second copy in memory.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        ~MappedFile();
+
+        // Fails on missing and empty files
+        bool Open(const char* path);
+        void Close();
+
+        inline const unsigned char* Data() const
+        {
+            return mData;
+        }
+
+        inline size_t Size() const
+        {
+            return mSize;
+        }
+
+        inline bool IsOpen() const
+        {
+            return mData != nullptr;
+        }
+
+    private:
+        const unsigned char* mData = nullptr;
+        size_t mSize = 0;
+    };
+
+    // Elements owned by the array, or a view of elements stored elsewhere, usually in a MappedFile kept
+    // alive by whoever holds the array. Both read the same. Writes go through Resize, which turns a view
+    // into an owned copy first, so a view is never written to.
+    template <typename T>
+    class Array
+    {
+    public:
+        Array() = default;
+
+        Array(const std::vector<T>& elements)
+            : mElements(elements), mData(mElements.data()), mSize(mElements.size())
+        {}
+
+        Array(const Array& other)
+        {
+            *this = other;
+        }
+
+        Array(Array&& other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        Array& operator=(const Array& other)
+        {
+            if (this != &other)
+            {
+                mElements = other.IsView() ? std::vector<T>() : other.mElements;
+                mData = other.IsView() ? other.mData : mElements.data();
+                mSize = other.mSize;
+            }
+            return *this;
+        }
+
+        Array& operator=(Array&& other) noexcept
+        {
+            if (this != &other)
+            {
+                bool view = other.IsView();
+                mElements = std::move(other.mElements);
+                mData = view ? other.mData : mElements.data();
+                mSize = other.mSize;
+                other.mElements.clear();
+                other.mData = nullptr;
+                other.mSize = 0;
+            }
+            return *this;
+        }
+
+        // The caller keeps data alive for as long as the array and its copies are used
+        static Array View(const T* data, size_t count)
+        {
+            Array result;
+            result.mData = count > 0 ? data : nullptr;
+            result.mSize = count > 0 ? count : 0;
+            return result;
+        }
+
+        // Returns count owned elements to write to, the first ones keep their value
+        T* Resize(size_t count)
+        {
+            if (IsView())
+            {
+                mElements.assign(mData, mData + std::min(count, mSize));
+            }
+            mElements.resize(count);
+            mData = mElements.data();
+            mSize = count;
+            return mElements.data();
+        }
+
+        inline bool IsView() const
+        {
+            return mData != nullptr && mData != mElements.data();
+        }
+
+        inline const T* data() const
+        {
+            return mData;
+        }
+
+        inline size_t size() const
+        {
+            return mSize;
+        }
+
+        inline bool empty() const
+        {
+            return mSize == 0;
+        }
+
+        inline const T& operator[](size_t index) const
+        {
+            return mData[index];
+        }
+
+        inline const T* begin() const
+        {
+            return mData;
+        }
+
+        inline const T* end() const
+        {
+            return mData + mSize;
+        }
+
+    private:
+        std::vector<T> mElements;
+        const T* mData = nullptr;
+        size_t mSize = 0;
+    };
+}